@@ -22,8 +22,10 @@
  ****************************************************/
 
 #include "Adafruit_LEDBackpack.h"
+#include "Bitboard.h"
 
 // HTK16K33 I2C commands.
+#define HT16K33_CMD_DISPLAY_ADDRESS 0x00
 #define HT16K33_CMD_BLINK           0x80
 #define HT16K33_BLINK_DISPLAYON     0x01
 #define HT16K33_CMD_BRIGHTNESS      0xE0
@@ -35,9 +37,16 @@ void Adafruit_LEDBackpack::setBrightness(uint8_t brightness)
 {
     if (brightness > 15)
         brightness = 15;
+    // Don't resend the brightness which the HT16K33 already has unless that write failed.
+    if (brightness == m_brightness && !m_brightnessTransfer.hasFailed())
+    {
+        m_stats.skipped++;
+        return;
+    }
+    m_brightness = brightness;
 
-    char command = HT16K33_CMD_BRIGHTNESS | brightness;
-    m_pI2C->write(m_i2cAddress, &command, sizeof(command));
+    uint8_t command = HT16K33_CMD_BRIGHTNESS | brightness;
+    m_pI2C->queueWrite(&m_brightnessTransfer, m_i2cAddress, &command, sizeof(command));
 }
 
 void Adafruit_LEDBackpack::blinkRate(uint8_t rate)
@@ -45,9 +54,15 @@ void Adafruit_LEDBackpack::blinkRate(uint8_t rate)
     // turn off if not sure.
     if (rate > HT16K33_BLINK_HALFHZ)
         rate = HT16K33_BLINK_OFF;
+    if (rate == m_blinkRate && !m_blinkTransfer.hasFailed())
+    {
+        m_stats.skipped++;
+        return;
+    }
+    m_blinkRate = rate;
 
-    char command = HT16K33_CMD_BLINK | HT16K33_BLINK_DISPLAYON | (rate << 1);
-    m_pI2C->write(m_i2cAddress, &command, sizeof(command));
+    uint8_t command = HT16K33_CMD_BLINK | HT16K33_BLINK_DISPLAYON | (rate << 1);
+    m_pI2C->queueWrite(&m_blinkTransfer, m_i2cAddress, &command, sizeof(command));
 }
 
 void Adafruit_LEDBackpack::begin(uint8_t i2cAddress /* = 0x70 */)
@@ -57,9 +72,12 @@ void Adafruit_LEDBackpack::begin(uint8_t i2cAddress /* = 0x70 */)
     // uses the 7-bit address and mbed uses the 8-bit address.
     m_i2cAddress = i2cAddress << 1;
 
-    char command = HT16K33_CMD_OSCILLATOR_ON;
-    m_pI2C->write(m_i2cAddress, &command, sizeof(command));
+    uint8_t command = HT16K33_CMD_OSCILLATOR_ON;
+    m_pI2C->queueWrite(&m_oscillatorTransfer, m_i2cAddress, &command, sizeof(command));
 
+    // The HT16K33 may have been left in any state so always send its initial settings.
+    m_blinkRate = HT16K33_UNKNOWN_SETTING;
+    m_brightness = HT16K33_UNKNOWN_SETTING;
     blinkRate(HT16K33_BLINK_OFF);
 
     setBrightness(BRIGHTNESS_MAX);
@@ -67,16 +85,44 @@ void Adafruit_LEDBackpack::begin(uint8_t i2cAddress /* = 0x70 */)
 
 void Adafruit_LEDBackpack::writeDisplay(void)
 {
-    // First byte of display buffer was reserved for address command.
-    // Start at address 0.
-    m_displayBuffer[0] = 0x00;
-
-    m_pI2C->write(m_i2cAddress, (const char*)m_displayBuffer, sizeof(m_displayBuffer));
+    uint16_t dirtyMask = m_dirtyMask;
+
+    // The display transfer is latest wins so this write will replace any previous one which hasn't been sent yet.
+    // Those bytes need to be included in this write as well. The same goes for a previous write which failed.
+    if (m_displayTransfer.isUnsent() || m_displayTransfer.hasFailed())
+    {
+        dirtyMask |= m_queuedMask;
+    }
+    if (dirtyMask == 0)
+    {
+        // Nothing has changed so there is no need to touch the I2C bus.
+        return;
+    }
+
+    // Send just the contiguous range of display RAM which covers all of the modified bytes. The HT16K33 auto
+    // increments its address pointer as each byte is written.
+    uint32_t first = __builtin_ctz(dirtyMask);
+    uint32_t last = 31 - __builtin_clz(dirtyMask);
+    uint32_t byteCount = last - first + 1;
+    uint8_t  packet[1 + sizeof(m_displayBuffer)];
+
+    packet[0] = HT16K33_CMD_DISPLAY_ADDRESS | first;
+    memcpy(&packet[1], &m_displayBuffer[first], byteCount);
+    // A write staged behind one which is still on the bus is dropped if that one fails so remember the bytes of both.
+    if (m_displayTransfer.isBusy())
+        dirtyMask |= m_queuedMask;
+    m_pI2C->queueWrite(&m_displayTransfer, m_i2cAddress, packet, 1 + byteCount);
+
+    m_queuedMask = dirtyMask;
+    m_dirtyMask = 0;
 }
 
 void Adafruit_LEDBackpack::clear(void)
 {
     memset(m_displayBuffer, 0, sizeof(m_displayBuffer));
+
+    // Send the whole display RAM on the next writeDisplay() since its contents aren't known until it is first written.
+    m_dirtyMask = (1 << sizeof(m_displayBuffer)) - 1;
 }
 
 
@@ -92,11 +138,13 @@ void Adafruit_8x8matrix::drawPixel(int x, int y, bool color)
     // The pixels are stored with 0th pixel in lsb and then the byte rotated right by 1.
     x = (x + 7) & 7;
 
-    // The column bitmasks are sent in every other byte plus the first byte is reserved for the command.
+    // The column bitmasks are sent in every other byte.
+    uint8_t rowData = m_displayBuffer[y * 2];
     if (color)
-        m_displayBuffer[y * 2 + 1] |= (1 << x);
+        rowData |= (1 << x);
     else
-        m_displayBuffer[y * 2 + 1] &= ~(1 << x);
+        rowData &= ~(1 << x);
+    updateDisplayByte(y * 2, rowData);
 }
 
 void Adafruit_8x8matrix::drawRow(int row, uint8_t rowData)
@@ -106,5 +154,32 @@ void Adafruit_8x8matrix::drawRow(int row, uint8_t rowData)
 
     // The pixels are stored with left most pixel in lsb and rightmost pixel in msb and then rotated right by 1 bit.
     uint8_t rotatedData = (rowData >> 1) | ((rowData & 1) << 7);
-    m_displayBuffer[row * 2 + 1] = rotatedData;
+    updateDisplayByte(row * 2, rotatedData);
+}
+
+void Adafruit_8x8matrix::drawBitboard(uint64_t bitboard)
+{
+    // Rotate all 8 rows into the HT16K33 format at once and then just copy each row into the display buffer.
+    uint64_t rows = bitboardToHt16k33(bitboard);
+    for (int row = 0 ; row < 8 ; row++)
+    {
+        updateDisplayByte(row * 2, (uint8_t)rows);
+        rows >>= 8;
+    }
+}
+
+
+
+/******************************* 16x8 MATRIX OBJECT */
+void Adafruit_16x8matrix::drawBitboard(int half, uint64_t bitboard)
+{
+    if (half < 0 || half > 1)
+        return;
+
+    // Each row takes 2 bytes of display RAM, the first for the left half and the second for the right half.
+    for (int row = 0 ; row < 8 ; row++)
+    {
+        updateDisplayByte(row * 2 + half, (uint8_t)bitboard);
+        bitboard >>= 8;
+    }
 }
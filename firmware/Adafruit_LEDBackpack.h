@@ -25,6 +25,7 @@
 
 #include <stdint.h>
 #include <mbed.h>
+#include "I2CAsync.h"
 
 
 #define LED_ON  true
@@ -40,46 +41,112 @@
 #define HT16K33_BLINK_1HZ           2
 #define HT16K33_BLINK_HALFHZ        3
 
+// The number of bytes placed on the I2C bus by one HT16K33 command write (address + command), such as a brightness
+// or blink rate change. Used to estimate the I2C traffic saved by effects which avoid such writes.
+#define HT16K33_COMMAND_WRITE_BYTES 2
+
+
+// Value of m_brightness and m_blinkRate before the first write so that the first setting is always sent.
+#define HT16K33_UNKNOWN_SETTING     0xFF
+
 
 // this is the raw HT16K33 controller
 class Adafruit_LEDBackpack
 {
 public:
-    Adafruit_LEDBackpack(I2C* pI2C)
+    // The bus can be left as NULL if it is instead going to be provided later in the call to begin(). This allows
+    // arrays of backpacks to be declared.
+    Adafruit_LEDBackpack(I2CAsync* pI2C = NULL) : m_oscillatorTransfer(false)
     {
         m_pI2C = pI2C;
+        m_i2cAddress = 0x70 << 1;
+        m_queuedMask = 0;
+        m_brightness = HT16K33_UNKNOWN_SETTING;
+        m_blinkRate = HT16K33_UNKNOWN_SETTING;
+        memset(&m_stats, 0, sizeof(m_stats));
+        m_oscillatorTransfer.setStats(&m_stats);
+        m_blinkTransfer.setStats(&m_stats);
+        m_brightnessTransfer.setStats(&m_stats);
+        m_displayTransfer.setStats(&m_stats);
         clear();
     }
 
     // Should be first call to backpack. Initializes the backpack, sets to maximum brightness, and makes sure that
     // blinking is disabled.
     void begin(uint8_t i2cAddress = 0x70);
+    // Same as above but also specifies the I2C bus to which the backpack is attached.
+    void begin(I2CAsync* pI2C, uint8_t i2cAddress)
+    {
+        m_pI2C = pI2C;
+        begin(i2cAddress);
+    }
     // Used to set the brightness of all LEDs that are on. Can't be used to individually set the brightness of LEDs.
-    // Valid values for brightness are between 0 and 15 (BRIGHTNESS_MIN and BRIGHTNESS_MAX).
+    // Valid values for brightness are between 0 and 15 (BRIGHTNESS_MIN and BRIGHTNESS_MAX). Nothing is sent if the
+    // HT16K33 already has this brightness.
     void setBrightness(uint8_t brightness);
     // Set the blink rate. Allowed values are HT16K33_BLINK_OFF, HT16K33_BLINK_2HZ, HT16K33_BLINK_1HZ, or
-    // HT16K33_BLINK_HALFHZ.
+    // HT16K33_BLINK_HALFHZ. The HT16K33 blinks the whole display on its own so no further I2C traffic is needed until
+    // the rate is changed again. Nothing is sent if the HT16K33 is already blinking at this rate.
     void blinkRate(uint8_t rate);
-    // Display the current contents of the display buffer to the RAM of the HT16K33.
+    // Queue up the parts of the display buffer which have changed since the last call to be sent to the RAM of the
+    // HT16K33. Returns immediately and the data is sent in the background by the I2CAsync bus. Nothing is sent at all
+    // if the display buffer hasn't changed.
     void writeDisplay(void);
+    // Returns the status of the most recent writeDisplay(). Will be I2C_TRANSFER_COMPLETE once the HT16K33 has
+    // received the data.
+    I2CTransferStatus getDisplayStatus(void)
+    {
+        return m_displayTransfer.getStatus();
+    }
+    // Returns the counters for all of the I2C traffic sent to this HT16K33 since it was constructed.
+    const I2CDeviceStats* getStats(void)
+    {
+        return &m_stats;
+    }
     // Clears out the display buffer. An immediate call to writeDisplay() after this would turn off all of the LEDs.
     void clear(void);
 
     // The HTK16K33 has a RAM which can hold 8 rows of 16 columns (2 bytes per row).
-    // Allocate an extra byte to hold initial write command byte so that everything can be sent out in one I2C write
-    // transaction.
-    uint8_t m_displayBuffer[8 * 2 + 1];
+    // Should only be modified through drawPixel()/drawRow() so that the changed bytes get tracked in m_dirtyMask.
+    uint8_t m_displayBuffer[8 * 2];
 
 protected:
-    I2C*    m_pI2C;
-    uint8_t m_i2cAddress;
+    // Flag that the specified byte of the display buffer should be sent on the next writeDisplay() if newValue is
+    // different than what it contains now.
+    void updateDisplayByte(int index, uint8_t newValue)
+    {
+        if (m_displayBuffer[index] != newValue)
+        {
+            m_displayBuffer[index] = newValue;
+            m_dirtyMask |= 1 << index;
+        }
+    }
+
+    // Each type of write gets its own transfer object so that they can all be queued at the same time. All but the
+    // oscillator write are latest wins so that only the newest brightness, blink rate, or display contents are sent
+    // if the caller updates them faster than the I2C bus can keep up.
+    I2CTransfer    m_oscillatorTransfer;
+    I2CTransfer    m_blinkTransfer;
+    I2CTransfer    m_brightnessTransfer;
+    I2CTransfer    m_displayTransfer;
+    I2CDeviceStats m_stats;
+    I2CAsync*      m_pI2C;
+    // Each bit represents one byte of display RAM. m_dirtyMask tracks the bytes modified since the last writeDisplay()
+    // and m_queuedMask tracks the bytes which need to be sent again if the last writeDisplay() fails. That includes
+    // the bytes of the write it was staged behind since I2CAsync drops both when that earlier write fails.
+    uint16_t       m_dirtyMask;
+    uint16_t       m_queuedMask;
+    uint8_t        m_i2cAddress;
+    // The brightness and blink rate most recently queued up for the HT16K33 so that repeats can be skipped.
+    uint8_t        m_brightness;
+    uint8_t        m_blinkRate;
 };
 
 
 class Adafruit_8x8matrix : public Adafruit_LEDBackpack
 {
 public:
-    Adafruit_8x8matrix(I2C* pI2C) : Adafruit_LEDBackpack(pI2C)
+    Adafruit_8x8matrix(I2CAsync* pI2C = NULL) : Adafruit_LEDBackpack(pI2C)
     {
     }
 
@@ -91,6 +158,27 @@ public:
     // writeDisplay() to actually send the pixel data to the internal RAM of the HT16K33. The leftmost pixel for the
     // row is taken from the lsb of rowData and the right pixel for the row is taken from the msb of rowData.
     void drawRow(int row, uint8_t rowData);
+
+    // Draws all 64 pixels of the matrix from a bitboard (see Bitboard.h for its format). Still need a subsequent call
+    // to writeDisplay() to actually send the pixel data to the internal RAM of the HT16K33.
+    void drawBitboard(uint64_t bitboard);
+};
+
+
+// 16x8 matrix backpack. Its display RAM holds 8 rows of 16 pixels so it is driven as two 8x8 halves side by side.
+// Assumes the columns are wired in order to the ROW0-15 pins and the rows to the COM0-7 pins with no rotation.
+class Adafruit_16x8matrix : public Adafruit_LEDBackpack
+{
+public:
+    Adafruit_16x8matrix(I2CAsync* pI2C = NULL) : Adafruit_LEDBackpack(pI2C)
+    {
+    }
+
+    // Draws all 64 pixels of one half of the matrix from a bitboard (see Bitboard.h for its format). Still need a
+    // subsequent call to writeDisplay() to actually send the pixel data to the internal RAM of the HT16K33.
+    //  half is 0 for the left 8 columns or 1 for the right 8 columns.
+    //  bitboard is the image to be drawn into that half.
+    void drawBitboard(int half, uint64_t bitboard);
 };
 
 #endif // Adafruit_LEDBackpack_h
@@ -70,35 +70,110 @@ AnimationBase::AnimationBase()
     m_pCurr = NULL;
     m_pInterpolating = NULL;
     m_pRgbPixels = NULL;
+    m_pHsvKeyFrames = NULL;
     m_pHsvPrev = NULL;
     m_pHsvNext = NULL;
+    m_maxKeyFrames = 0;
+    m_pInterpolators = NULL;
+    m_pHsvRendered = NULL;
+    m_pFrameStartTimes = NULL;
     m_pixelCount = 0;
-    m_lastRenderTime = 0xFFFFFFFF;
+    m_loopTime = 0;
+    m_currTime = 0;
+    m_lastTickTime = 0;
+    m_lastRenderTime = -1;
+    m_interpolatedTime = 0;
+    m_interpolationMode = INTERPOLATE_INCREMENTAL;
+    m_activeInterpolationMode = INTERPOLATE_INCREMENTAL;
+    m_isRenderForced = false;
     m_dirty = false;
-    m_timer.start();
 }
 
 void AnimationBase::setKeyFrames(const AnimationKeyFrame* pFrames, size_t frameCount)
 {
+    assert ( frameCount > 0 && frameCount <= m_maxKeyFrames );
+
+    // Want to interpolate between HSV values so convert all of the frames to that colour space up front.
+    for (size_t i = 0 ; i < frameCount ; i++)
+    {
+        convertRgbPixelsToHsv(&m_pHsvKeyFrames[i * m_pixelCount], pFrames[i].pPixels, m_pixelCount);
+    }
+
+    // Build the index of when each key frame starts so that the frame for any point in the animation can be found
+    // with a binary search.
+    uint32_t startTime = 0;
+    for (size_t i = 0 ; i < frameCount ; i++)
+    {
+        assert ( pFrames[i].millisecondsBeforeNextFrame >= 0 );
+        m_pFrameStartTimes[i] = startTime;
+        startTime += pFrames[i].millisecondsBeforeNextFrame;
+    }
+    assert ( startTime > 0 );
+    m_loopTime = startTime;
+
     m_pStart = pFrames;
     m_pEnd = pFrames + frameCount;
-    m_pCurr = pFrames;
+    seek(0);
+}
+
+void AnimationBase::seek(uint32_t milliseconds)
+{
+    m_currTime = milliseconds % m_loopTime;
+    m_lastTickTime = us_ticker_read();
+    m_pCurr = NULL;
+    m_pCurr = findKeyFrame(m_currTime);
     m_pInterpolating = NULL;
-    m_timer.reset();
-    m_lastRenderTime = 0xFFFFFFFF;
+    m_lastRenderTime = -1;
     m_dirty = true;
 }
 
+void AnimationBase::advanceTime()
+{
+    // Only the whole milliseconds are taken off of the tick count so that the left over fraction of a millisecond
+    // counts towards the next update. This keeps the animation from drifting no matter how often it gets updated.
+    uint32_t elapsed = (us_ticker_read() - m_lastTickTime) / 1000;
+    m_lastTickTime += elapsed * 1000;
+    m_currTime += elapsed;
+    if (m_currTime >= m_loopTime)
+    {
+        m_currTime %= m_loopTime;
+    }
+}
+
+const AnimationKeyFrame* AnimationBase::findKeyFrame(uint32_t time)
+{
+    // Most of the time it is still the same key frame as the last update.
+    size_t curr = m_pCurr ? m_pCurr - m_pStart : 0;
+    size_t frameCount = m_pEnd - m_pStart;
+    if (m_pCurr && time >= m_pFrameStartTimes[curr] &&
+        (curr + 1 >= frameCount || time < m_pFrameStartTimes[curr + 1]))
+    {
+        return m_pCurr;
+    }
+
+    // Otherwise find the last key frame which starts at or before this time. Any key frames with a time of 0 share
+    // their start time with the frame after them so they are skipped over.
+    size_t low = 0;
+    size_t high = frameCount - 1;
+    while (low < high)
+    {
+        size_t middle = (low + high + 1) / 2;
+        if (m_pFrameStartTimes[middle] <= time)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return m_pStart + low;
+}
+
 void AnimationBase::updatePixels(NeoPixel& ledControl)
 {
-    if (m_timer.read_ms() > m_pCurr->millisecondsBeforeNextFrame)
+    // Find where the animation should be now, even if the main loop fell behind by more than a whole key frame.
+    advanceTime();
+    const AnimationKeyFrame* pFrame = findKeyFrame(m_currTime);
+    if (pFrame != m_pCurr)
     {
-        m_pCurr++;
-        if (m_pCurr >= m_pEnd)
-        {
-            m_pCurr = m_pStart;
-        }
-        m_timer.reset();
+        m_pCurr = pFrame;
         m_dirty = true;
     }
 
@@ -125,28 +200,44 @@ void AnimationBase::updatePixelsInterpolated(NeoPixel& ledControl)
 {
     if (m_pCurr != m_pInterpolating)
     {
-        // Want to interpolate between HSV values so convert the two frames to that colour space at the beginning of
-        // an interpolation sequence.
-        convertRgbPixelsToHsv(m_pHsvPrev, m_pCurr->pPixels, m_pixelCount);
-
+        // Interpolate between the HSV forms of the two frames which were calculated in setKeyFrames().
         const AnimationKeyFrame* pNextFrame = m_pCurr + 1;
         if (pNextFrame >= m_pEnd)
         {
             pNextFrame = m_pStart;
         }
-        convertRgbPixelsToHsv(m_pHsvNext, pNextFrame->pPixels, m_pixelCount);
+        m_pHsvPrev = &m_pHsvKeyFrames[(m_pCurr - m_pStart) * m_pixelCount];
+        m_pHsvNext = &m_pHsvKeyFrames[(pNextFrame - m_pStart) * m_pixelCount];
 
-        m_lastRenderTime = 0xFFFFFFFF;
+        m_activeInterpolationMode = (m_pCurr->easing == EASE_LINEAR) ? m_interpolationMode : INTERPOLATE_DIRECT;
+        if (m_activeInterpolationMode == INTERPOLATE_INCREMENTAL)
+        {
+            startIncrementalInterpolation(m_pCurr->millisecondsBeforeNextFrame);
+        }
+        m_lastRenderTime = -1;
         m_pInterpolating = m_pCurr;
     }
 
     // Don't render the interpolation more than once per millisecond.
-    int32_t currTime = m_timer.read_ms();
-    if (currTime != m_lastRenderTime)
+    int32_t currTime = m_currTime - m_pFrameStartTimes[m_pCurr - m_pStart];
+    if (currTime == m_lastRenderTime)
+    {
+        return;
+    }
+    m_lastRenderTime = currTime;
+
+    if (m_activeInterpolationMode == INTERPOLATE_INCREMENTAL)
     {
-        interpolateBetweenKeyFrames(currTime, m_pCurr->millisecondsBeforeNextFrame);
+        // Only send the pixels if at least one of them has visibly changed.
+        if (interpolateIncrementally(currTime, m_pCurr->millisecondsBeforeNextFrame))
+        {
+            ledControl.set(m_pRgbPixels, m_pixelCount);
+        }
+    }
+    else
+    {
+        interpolateBetweenKeyFrames(currTime, m_pCurr->millisecondsBeforeNextFrame, m_pCurr->easing);
         ledControl.set(m_pRgbPixels, m_pixelCount);
-        m_lastRenderTime = currTime;
     }
 }
 
@@ -167,35 +258,182 @@ void AnimationBase::rgbToInterpolatableHsv(HSVData* pHsvDest, const RGBData* pRg
     pHsvDest->value = s_logTable[pHsvDest->value];
 }
 
-void AnimationBase::interpolateBetweenKeyFrames(int32_t currTime, int32_t totalTime)
+void AnimationBase::interpolateBetweenKeyFrames(int32_t currTime, int32_t totalTime, EasingCurve easing)
 {
     const HSVData* pPrev = m_pHsvPrev;
     const HSVData* pNext = m_pHsvNext;
     RGBData* pRgb = m_pRgbPixels;
 
+    // Every pixel is at the same point in the interpolation (and on the same easing curve) so only divide once for all
+    // of them.
+    uint32_t fraction = easeFraction(easing, calculateInterpolationFraction(currTime, totalTime));
     for (size_t i = 0 ; i < m_pixelCount ; i++)
     {
-        interpolateHsvToRgb(pRgb++, pPrev++, pNext++, currTime, totalTime);
+        interpolateHsvToRgbByFraction(pRgb++, pPrev++, pNext++, fraction);
     }
 }
 
+static inline int32_t calculateChannelDelta(int32_t prev, int32_t next, int32_t totalTime)
+{
+    // Round the magnitude of the delta up, the same as calculateInterpolationFraction(), so that truncating the
+    // accumulated change gives the same values as the direct interpolation.
+    if (next >= prev)
+        return ((next - prev) * INTERPOLATION_FRACTION_ONE + totalTime - 1) / totalTime;
+    else
+        return -(((prev - next) * INTERPOLATION_FRACTION_ONE + totalTime - 1) / totalTime);
+}
+
+static inline int32_t applyChannelChange(int32_t prev, int32_t change)
+{
+    // Truncate the Q16 change towards zero.
+    if (change >= 0)
+        return prev + (change >> INTERPOLATION_FRACTION_SHIFT);
+    else
+        return prev - (-change >> INTERPOLATION_FRACTION_SHIFT);
+}
+
+void AnimationBase::startIncrementalInterpolation(int32_t totalTime)
+{
+    assert ( totalTime > 0 );
+
+    const HSVData*     pPrev = m_pHsvPrev;
+    const HSVData*     pNext = m_pHsvNext;
+    PixelInterpolator* pInterpolator = m_pInterpolators;
+
+    // The divisions are all done here, once per interpolation.
+    for (size_t i = 0 ; i < m_pixelCount ; i++)
+    {
+        pInterpolator->hueChange = 0;
+        pInterpolator->saturationChange = 0;
+        pInterpolator->valueChange = 0;
+        pInterpolator->hueDelta = calculateChannelDelta(pPrev->hue, pNext->hue, totalTime);
+        pInterpolator->saturationDelta = calculateChannelDelta(pPrev->saturation, pNext->saturation, totalTime);
+        pInterpolator->valueDelta = calculateChannelDelta(pPrev->value, pNext->value, totalTime);
+        pInterpolator++;
+        pPrev++;
+        pNext++;
+    }
+
+    // Make sure that every pixel is converted on the first millisecond.
+    m_isRenderForced = true;
+    m_interpolatedTime = 0;
+}
+
+bool AnimationBase::interpolateIncrementally(int32_t currTime, int32_t totalTime)
+{
+    // The main loop normally gets here every millisecond but it can fall behind so step over all of the milliseconds
+    // since the last update at once. Don't step past the next key frame if it is late in switching to it.
+    if (currTime > totalTime)
+        currTime = totalTime;
+    int32_t elapsed = currTime - m_interpolatedTime;
+    m_interpolatedTime = currTime;
+
+    const HSVData*     pPrev = m_pHsvPrev;
+    PixelInterpolator* pInterpolator = m_pInterpolators;
+    HSVData*           pRendered = m_pHsvRendered;
+    RGBData*           pRgb = m_pRgbPixels;
+    bool               isChanged = false;
+    for (size_t i = 0 ; i < m_pixelCount ; i++)
+    {
+        if (elapsed == 1)
+        {
+            pInterpolator->hueChange += pInterpolator->hueDelta;
+            pInterpolator->saturationChange += pInterpolator->saturationDelta;
+            pInterpolator->valueChange += pInterpolator->valueDelta;
+        }
+        else
+        {
+            pInterpolator->hueChange += pInterpolator->hueDelta * elapsed;
+            pInterpolator->saturationChange += pInterpolator->saturationDelta * elapsed;
+            pInterpolator->valueChange += pInterpolator->valueDelta * elapsed;
+        }
+
+        // Only run the expensive HSV to RGB conversion for pixels which have changed by at least one LSB.
+        HSVData interpolated;
+        interpolated.hue = applyChannelChange(pPrev->hue, pInterpolator->hueChange);
+        interpolated.saturation = applyChannelChange(pPrev->saturation, pInterpolator->saturationChange);
+        interpolated.value = applyChannelChange(pPrev->value, pInterpolator->valueChange);
+        if (m_isRenderForced ||
+            interpolated.hue != pRendered->hue ||
+            interpolated.saturation != pRendered->saturation ||
+            interpolated.value != pRendered->value)
+        {
+            *pRendered = interpolated;
+
+            // Use an exponential curve for brightness to make the interpolation perception smoother to the human eye.
+            interpolated.value = s_powerTable[interpolated.value];
+            hsvToRgb(pRgb, &interpolated);
+            isChanged = true;
+        }
+        pPrev++;
+        pInterpolator++;
+        pRendered++;
+        pRgb++;
+    }
+    m_isRenderForced = false;
+
+    return isChanged;
+}
+
 void AnimationBase::interpolateHsvToRgb(RGBData* pRgbDest, const HSVData* pHsvStart, const HSVData* pHsvStop,
                                     int32_t curr, int32_t total)
 {
-    HSVData interpolated;
+    interpolateHsvToRgbByFraction(pRgbDest, pHsvStart, pHsvStop, calculateInterpolationFraction(curr, total));
+}
 
-    int32_t huePrev = pHsvStart->hue;
-    int32_t hueNext = pHsvStop->hue;
-    interpolated.hue = huePrev + ((hueNext - huePrev) * curr) / total;
+uint32_t AnimationBase::calculateInterpolationFraction(int32_t curr, int32_t total)
+{
+    assert ( total > 0 );
+
+    // Callers can be a millisecond past the end of the interpolation before they notice and move on.
+    if (curr < 0)
+        curr = 0;
+    if (curr > total)
+        curr = total;
+
+    // Keep curr in the upper 16 bits for interpolations longer than 65 seconds. Dropping the low bits of both times
+    // changes the fraction by much less than 1 LSB.
+    uint32_t unsignedCurr = curr;
+    uint32_t unsignedTotal = total;
+    while (unsignedTotal >= INTERPOLATION_FRACTION_ONE)
+    {
+        unsignedCurr >>= 1;
+        unsignedTotal >>= 1;
+    }
 
-    int32_t saturationPrev = pHsvStart->saturation;
-    int32_t saturationNext = pHsvStop->saturation;
-    interpolated.saturation = saturationPrev + ((saturationNext - saturationPrev) * curr) / total;
+    // Round up so that the truncating multiply in interpolateChannel() lands on the same value as the division did for
+    // all but the longest of interpolations.
+    return ((unsignedCurr << INTERPOLATION_FRACTION_SHIFT) + unsignedTotal - 1) / unsignedTotal;
+}
+
+static inline int32_t interpolateChannel(int32_t prev, int32_t next, uint32_t fraction)
+{
+    // Scale the magnitude of the change so that it is truncated towards zero, the same as the integer division that
+    // it replaces. The change is at most 255 and eased fractions are less than 2 so the product fits in 32 bits.
+    int32_t value;
+    if (next >= prev)
+        value = prev + (int32_t)(((uint32_t)(next - prev) * fraction) >> INTERPOLATION_FRACTION_SHIFT);
+    else
+        value = prev - (int32_t)(((uint32_t)(prev - next) * fraction) >> INTERPOLATION_FRACTION_SHIFT);
+
+    // Easing curves which overshoot can carry the channel past either end of its range.
+    if (value < 0)
+        return 0;
+    if (value > 255)
+        return 255;
+    return value;
+}
+
+void AnimationBase::interpolateHsvToRgbByFraction(RGBData* pRgbDest, const HSVData* pHsvStart,
+                                                  const HSVData* pHsvStop, uint32_t fraction)
+{
+    HSVData interpolated;
+
+    interpolated.hue = interpolateChannel(pHsvStart->hue, pHsvStop->hue, fraction);
+    interpolated.saturation = interpolateChannel(pHsvStart->saturation, pHsvStop->saturation, fraction);
 
     // Use an exponential curve for brightness to make the interpolation perception smoother to the human eye.
-    int32_t valuePrev = pHsvStart->value;
-    int32_t valueNext = pHsvStop->value;
-    int32_t newValue = (valuePrev + ((valueNext - valuePrev) * curr) / total);
+    int32_t newValue = interpolateChannel(pHsvStart->value, pHsvStop->value, fraction);
     interpolated.value = s_powerTable[newValue];
 
     hsvToRgb(pRgbDest, &interpolated);
@@ -210,8 +448,11 @@ TwinkleAnimationBase::TwinkleAnimationBase()
     m_pRgbPixels = NULL;
     m_pHsvPixels = NULL;
     m_pTwinkleInfo = NULL;
+    m_pActivePixels = NULL;
+    m_activeCount = 0;
     m_pixelCount = 0;
     m_lastUpdate = -1;
+    m_isRenderForced = false;
     m_timer.start();
 }
 
@@ -221,7 +462,10 @@ void TwinkleAnimationBase::setProperties(const TwinkleProperties* pProperties)
     memset(m_pRgbPixels, 0, sizeof(*m_pRgbPixels) * m_pixelCount);
     memset(m_pHsvPixels, 0, sizeof(*m_pHsvPixels) * m_pixelCount);
     memset(m_pTwinkleInfo, 0, sizeof(*m_pTwinkleInfo) * m_pixelCount);
+    m_activeCount = 0;
 
+    // Make sure that the cleared pixels are sent on the first update.
+    m_isRenderForced = true;
     m_lastUpdate = -1;
     m_timer.reset();
 }
@@ -236,31 +480,37 @@ void TwinkleAnimationBase::updatePixels(NeoPixel& ledControl)
     }
     m_lastUpdate = currTime;
 
-    // Animate twinkles already in progress.
-    HSVData* pHsvPixel = m_pHsvPixels;
-    HSVData* pEnd = m_pHsvPixels + m_pixelCount;
-    RGBData* pRgbPixel = m_pRgbPixels;
-    PixelTwinkleInfo* pInfo = m_pTwinkleInfo;
-    while (pHsvPixel < pEnd)
+    // Animate twinkles already in progress. Only the pixels on the active list are visited and the ones which finish
+    // are removed by moving the last entry of the list into their place.
+    bool   isChanged = m_isRenderForced;
+    size_t i = 0;
+    while (i < m_activeCount)
     {
-        twinklePixel(pRgbPixel++, pHsvPixel++, pInfo++, currTime);
+        uint16_t          pixel = m_pActivePixels[i];
+        PixelTwinkleInfo* pInfo = &m_pTwinkleInfo[pixel];
+
+        isChanged |= twinklePixel(&m_pRgbPixels[pixel], &m_pHsvPixels[pixel], pInfo, currTime);
+        if (pInfo->lifetime == 0)
+            m_pActivePixels[i] = m_pActivePixels[--m_activeCount];
+        else
+            i++;
     }
 
     // Randomly start twinkling pixels.
     if (posRand() % m_pProperties->probability != 0)
     {
         // Don't need to start another twinkle at this time.
-        ledControl.set(m_pRgbPixels, m_pixelCount);
+        sendPixelsIfChanged(ledControl, isChanged);
         return;
     }
 
     // Pick the pixel to twinkle.
     int pixelToTwinkle = posRand() % m_pixelCount;
-    pInfo = &m_pTwinkleInfo[pixelToTwinkle];
+    PixelTwinkleInfo* pInfo = &m_pTwinkleInfo[pixelToTwinkle];
     if (pInfo->lifetime != 0)
     {
         // Don't bother since it is already in the process of twinkling.
-        ledControl.set(m_pRgbPixels, m_pixelCount);
+        sendPixelsIfChanged(ledControl, isChanged);
         return;
     }
 
@@ -269,8 +519,10 @@ void TwinkleAnimationBase::updatePixels(NeoPixel& ledControl)
     pInfo->lifetime = m_pProperties->lifetimeMin + (lifetimeDelta ? posRand() % lifetimeDelta : 0);
     pInfo->startTime = currTime;
     pInfo->isGettingBrighter = true;
+    assert ( m_activeCount < m_pixelCount );
+    m_pActivePixels[m_activeCount++] = pixelToTwinkle;
 
-    pHsvPixel = &m_pHsvPixels[pixelToTwinkle];
+    HSVData* pHsvPixel = &m_pHsvPixels[pixelToTwinkle];
     uint8_t hueDelta = m_pProperties->hueMax - m_pProperties->hueMin;
     uint8_t saturationDelta = m_pProperties->saturationMax - m_pProperties->saturationMin;
     uint8_t valueDelta = m_pProperties->valueMax - m_pProperties->valueMin;
@@ -282,10 +534,20 @@ void TwinkleAnimationBase::updatePixels(NeoPixel& ledControl)
     // Set RGB pixel value to match starting colour.
     HSVData hsvStart = *pHsvPixel;
     hsvStart.value = 8;
-    pRgbPixel = &m_pRgbPixels[pixelToTwinkle];
+    RGBData* pRgbPixel = &m_pRgbPixels[pixelToTwinkle];
     hsvToRgb(pRgbPixel, &hsvStart);
 
-    ledControl.set(m_pRgbPixels, m_pixelCount);
+    sendPixelsIfChanged(ledControl, true);
+}
+
+void TwinkleAnimationBase::sendPixelsIfChanged(NeoPixel& ledControl, bool isChanged)
+{
+    // Idle milliseconds, where no twinkle changed colour, leave the strip showing what it already has.
+    if (isChanged)
+    {
+        ledControl.set(m_pRgbPixels, m_pixelCount);
+        m_isRenderForced = false;
+    }
 }
 
 static unsigned int posRand()
@@ -293,17 +555,20 @@ static unsigned int posRand()
     return (unsigned int)rand();
 }
 
-void TwinkleAnimationBase::twinklePixel(RGBData* pRgbDest,
-                                    const HSVData* pHsv,
-                                    PixelTwinkleInfo* pInfo,
-                                    uint32_t currTime)
+bool TwinkleAnimationBase::twinklePixel(RGBData* pRgbDest,
+                                        const HSVData* pHsv,
+                                        PixelTwinkleInfo* pInfo,
+                                        uint32_t currTime)
 {
     if (pInfo->lifetime == 0)
     {
         // This pixel isn't twinkling so just return.
-        return;
+        return false;
     }
 
+    // Remember the current colour so that the caller can be told if it has changed.
+    RGBData prevRgb = *pRgbDest;
+
     uint32_t deltaTime = currTime - pInfo->startTime;
     if (pInfo->isGettingBrighter)
     {
@@ -332,13 +597,15 @@ void TwinkleAnimationBase::twinklePixel(RGBData* pRgbDest,
             // The twinkle is complete so flag it as being so and turn LED off.
             pInfo->lifetime = 0;
             *pRgbDest = { 0, 0, 0 };
-            return;
+            return true;
         }
         HSVData hsvStart = *pHsv;
         HSVData hsvStop = *pHsv;
         hsvStop.value = 8;
         AnimationBase::interpolateHsvToRgb(pRgbDest, &hsvStart, &hsvStop, deltaTime, pInfo->lifetime);
     }
+
+    return pRgbDest->red != prevRgb.red || pRgbDest->green != prevRgb.green || pRgbDest->blue != prevRgb.blue;
 }
 
 
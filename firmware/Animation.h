@@ -17,14 +17,24 @@
 
 #include <assert.h>
 #include <mbed.h>
+#include "Easing.h"
 #include "NeoPixel.h"
 
 
+// The Q16 fixed point interpolation fraction for being all of the way to the end of an interpolation. Interpolation
+// fractions are passed straight through easeFraction() so they must use the same fixed point format.
+#define INTERPOLATION_FRACTION_SHIFT    16
+#define INTERPOLATION_FRACTION_ONE      (1 << INTERPOLATION_FRACTION_SHIFT)
+static_assert(INTERPOLATION_FRACTION_SHIFT == EASING_FRACTION_SHIFT, "Interpolation and easing fractions must match.");
+
+
 struct AnimationKeyFrame
 {
-    RGBData* pPixels;
-    int32_t  millisecondsBeforeNextFrame;
-    bool     interpolateBetweenFrames;
+    RGBData*    pPixels;
+    int32_t     millisecondsBeforeNextFrame;
+    bool        interpolateBetweenFrames;
+    // The curve used to ease the interpolation to the next key frame. Ignored if interpolateBetweenFrames is false.
+    EasingCurve easing;
 };
 
 class IPixelUpdate
@@ -36,9 +46,45 @@ public:
 class AnimationBase : public IPixelUpdate
 {
 public:
+    // The ways that pixels can be interpolated between key frames.
+    enum InterpolationMode
+    {
+        // Each pixel is recalculated from the key frames on either side of it every millisecond.
+        INTERPOLATE_DIRECT,
+        // Per millisecond deltas are calculated for each pixel at the start of the interpolation and then just added
+        // in each millisecond. Pixels which haven't changed enough to be visible aren't converted back to RGB again.
+        // The deltas only work for straight lines so key frames which use an easing curve other than EASE_LINEAR are
+        // always interpolated with INTERPOLATE_DIRECT.
+        INTERPOLATE_INCREMENTAL
+    };
 
+    // Starts the animation over with a new set of key frames. The HSV form of every key frame is calculated here, once,
+    // so that moving from one interpolation to the next doesn't have to convert any pixels. Should be called again if
+    // the pixels or times of the key frames are modified.
+    //  pFrames points to the array of key frames. They are played in order and then loop back to the first one. Each
+    //          one is shown for its millisecondsBeforeNextFrame and at least one of them must have a non-zero time.
+    //  frameCount is the number of key frames in pFrames. Can't be more than the MAX_KEY_FRAMES of the Animation.
     void setKeyFrames(const AnimationKeyFrame* pFrames, size_t frameCount);
 
+    // Jumps to a point in the animation. The animation keeps playing from there on the following calls to
+    // updatePixels().
+    //  milliseconds is the time from the start of the first key frame. Times past the end of the last key frame wrap
+    //               around since the animation loops.
+    void seek(uint32_t milliseconds);
+
+    // Returns the current time in the animation, in milliseconds from the start of the first key frame.
+    uint32_t getTime()
+    {
+        return m_currTime;
+    }
+
+    // Selects how pixels are interpolated between key frames. Defaults to INTERPOLATE_INCREMENTAL. Takes effect at the
+    // start of the next interpolation.
+    void setInterpolationMode(InterpolationMode mode)
+    {
+        m_interpolationMode = mode;
+    }
+
     // IPixelUpdate methods.
     virtual void updatePixels(NeoPixel& ledControl);
 
@@ -46,13 +92,42 @@ public:
     static void rgbToInterpolatableHsv(HSVData* pHsvDest, const RGBData* pRgbSrc);
     static void interpolateHsvToRgb(RGBData* pRgbDest, const HSVData* pHsvStart, const HSVData* pHsvStop,
                                     int32_t curr, int32_t total);
+
+    // Division free version of interpolateHsvToRgb() for interpolating many pixels at the same point in time. The
+    // fraction is calculated once with calculateInterpolationFraction() and then each pixel is interpolated with just
+    // multiplies and shifts. The interpolated HSV values are within 1 LSB of dividing by total for each pixel, and
+    // identical for interpolations of up to 256 steps.
+    //  curr is how far into the interpolation we are (0 - total).
+    //  total is the length of the whole interpolation. Must be greater than 0.
+    //  fraction is the Q16 fixed point value returned from calculateInterpolationFraction(). 0 gives pHsvStart and
+    //           INTERPOLATION_FRACTION_ONE gives pHsvStop. Can be eased with easeFraction() first, including past
+    //           INTERPOLATION_FRACTION_ONE, in which case each channel stops at the limit of its range.
+    static uint32_t calculateInterpolationFraction(int32_t curr, int32_t total);
+    static void     interpolateHsvToRgbByFraction(RGBData* pRgbDest, const HSVData* pHsvStart, const HSVData* pHsvStop,
+                                                  uint32_t fraction);
 protected:
     AnimationBase();
 
+    void                     advanceTime();
+    const AnimationKeyFrame* findKeyFrame(uint32_t time);
     void updatePixelsNonInterpolated(NeoPixel& ledControl);
     void updatePixelsInterpolated(NeoPixel& ledControl);
     void convertRgbPixelsToHsv(HSVData* pHsvDest, const RGBData* pRgbSrc, size_t pixelCount);
-    void interpolateBetweenKeyFrames(int32_t currTime, int32_t totalTime);
+    void interpolateBetweenKeyFrames(int32_t currTime, int32_t totalTime, EasingCurve easing);
+    void startIncrementalInterpolation(int32_t totalTime);
+    bool interpolateIncrementally(int32_t currTime, int32_t totalTime);
+
+    // The state of one pixel during an INTERPOLATE_INCREMENTAL interpolation. How far each channel has moved away from
+    // the previous key frame is kept in Q16 fixed point along with how much it moves each millisecond.
+    struct PixelInterpolator
+    {
+        int32_t hueChange;
+        int32_t saturationChange;
+        int32_t valueChange;
+        int32_t hueDelta;
+        int32_t saturationDelta;
+        int32_t valueDelta;
+    };
 
     static uint8_t           s_powerTable[256];
     static uint8_t           s_logTable[256];
@@ -61,30 +136,54 @@ protected:
     const AnimationKeyFrame* m_pCurr;
     const AnimationKeyFrame* m_pInterpolating;
     RGBData*                 m_pRgbPixels;
-    HSVData*                 m_pHsvPrev;
-    HSVData*                 m_pHsvNext;
+    // The HSV form of each key frame, as used for interpolation. Holds m_maxKeyFrames frames of m_pixelCount pixels.
+    HSVData*                 m_pHsvKeyFrames;
+    const HSVData*           m_pHsvPrev;
+    const HSVData*           m_pHsvNext;
+    size_t                   m_maxKeyFrames;
+    PixelInterpolator*       m_pInterpolators;
+    // The HSV value (before the brightness curve) from which each RGB pixel was last converted during an
+    // INTERPOLATE_INCREMENTAL interpolation.
+    HSVData*                 m_pHsvRendered;
+    // The time at which each key frame starts, in milliseconds from the start of the first key frame.
+    uint32_t*                m_pFrameStartTimes;
     size_t                   m_pixelCount;
-    Timer                    m_timer;
+    // The length of the whole animation, in milliseconds, before it loops.
+    uint32_t                 m_loopTime;
+    // The current time in the animation and the us_ticker time at which it was last advanced.
+    uint32_t                 m_currTime;
+    uint32_t                 m_lastTickTime;
     int32_t                  m_lastRenderTime;
+    int32_t                  m_interpolatedTime;
+    InterpolationMode        m_interpolationMode;
+    InterpolationMode        m_activeInterpolationMode;
+    bool                     m_isRenderForced;
     bool                     m_dirty;
 };
 
-template <size_t PIXEL_COUNT>
+// PIXEL_COUNT is the number of pixels in each key frame and MAX_KEY_FRAMES is the most key frames which can be passed
+// into setKeyFrames().
+template <size_t PIXEL_COUNT, size_t MAX_KEY_FRAMES>
 class Animation : public AnimationBase
 {
 public:
     Animation()
     {
         m_pRgbPixels = m_rgbPixels;
-        m_pHsvPrev = m_hsvPrevPixels;
-        m_pHsvNext = m_hsvNextPixels;
+        m_pHsvKeyFrames = &m_hsvKeyFrames[0][0];
+        m_maxKeyFrames = MAX_KEY_FRAMES;
+        m_pInterpolators = m_interpolators;
+        m_pHsvRendered = m_hsvRenderedPixels;
+        m_pFrameStartTimes = m_frameStartTimes;
         m_pixelCount = PIXEL_COUNT;
     }
 
 protected:
-    RGBData m_rgbPixels[PIXEL_COUNT];
-    HSVData m_hsvPrevPixels[PIXEL_COUNT];
-    HSVData m_hsvNextPixels[PIXEL_COUNT];
+    RGBData           m_rgbPixels[PIXEL_COUNT];
+    HSVData           m_hsvKeyFrames[MAX_KEY_FRAMES][PIXEL_COUNT];
+    PixelInterpolator m_interpolators[PIXEL_COUNT];
+    HSVData           m_hsvRenderedPixels[PIXEL_COUNT];
+    uint32_t          m_frameStartTimes[MAX_KEY_FRAMES];
 };
 
 
@@ -111,7 +210,8 @@ public:
 
     void setProperties(const TwinkleProperties* pProperties);
 
-    // IPixelUpdate methods.
+    // IPixelUpdate methods. Only the pixels which are twinkling are visited each millisecond and the pixels are only
+    // sent to ledControl when at least one of them has changed colour.
     virtual void updatePixels(NeoPixel& ledControl);
 
 protected:
@@ -123,33 +223,43 @@ protected:
         uint32_t lifetime;
         bool     isGettingBrighter;
     };
-    void twinklePixel(RGBData* pRgbDest, const HSVData* pHsv, PixelTwinkleInfo* pInfo, uint32_t currTime);
+    bool twinklePixel(RGBData* pRgbDest, const HSVData* pHsv, PixelTwinkleInfo* pInfo, uint32_t currTime);
+    void sendPixelsIfChanged(NeoPixel& ledControl, bool isChanged);
 
     const TwinkleProperties* m_pProperties;
     RGBData*                 m_pRgbPixels;
     HSVData*                 m_pHsvPixels;
     PixelTwinkleInfo*        m_pTwinkleInfo;
+    // The indices of the pixels which are currently twinkling, in no particular order. The first m_activeCount entries
+    // are valid.
+    uint16_t*                m_pActivePixels;
+    size_t                   m_activeCount;
     size_t                   m_pixelCount;
     Timer                    m_timer;
     int32_t                  m_lastUpdate;
+    bool                     m_isRenderForced;
 };
 
 template <size_t PIXEL_COUNT>
 class TwinkleAnimation : public TwinkleAnimationBase
 {
 public:
+    static_assert(PIXEL_COUNT <= 0xFFFF, "Active pixel indices are only 16-bits.");
+
     TwinkleAnimation()
     {
         m_pixelCount = PIXEL_COUNT;
         m_pRgbPixels = m_rgbPixels;
         m_pHsvPixels = m_hsvPixels;
         m_pTwinkleInfo = m_twinkleInfo;
+        m_pActivePixels = m_activePixels;
     }
 
 protected:
     RGBData          m_rgbPixels[PIXEL_COUNT];
     HSVData          m_hsvPixels[PIXEL_COUNT];
     PixelTwinkleInfo m_twinkleInfo[PIXEL_COUNT];
+    uint16_t         m_activePixels[PIXEL_COUNT];
 };
 
 
@@ -246,7 +356,8 @@ static inline void createInterpolatedPixelPattern(RGBData* pDest, size_t destPix
 
     for (int32_t i = 0 ; i < totalPixels ; i++)
     {
-        AnimationBase::interpolateHsvToRgb(pDest++, &hsvStart, &hsvStop, i, totalPixels);
+        uint32_t fraction = AnimationBase::calculateInterpolationFraction(i, totalPixels);
+        AnimationBase::interpolateHsvToRgbByFraction(pDest++, &hsvStart, &hsvStop, fraction);
     }
 }
 
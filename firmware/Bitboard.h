@@ -0,0 +1,179 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Operations on 8x8 monochrome images stored in a single 64-bit word (a bitboard).
+   Byte n of the word holds row n of the image, with row 0 at the top. Within each row, the lsb is the leftmost pixel
+   and the msb is the rightmost pixel. This is the same row format as used by EyeMatrices::drawRow().
+
+   The transpose uses the bit-matrix technique documented on the Chess Programming Wiki
+   (https://www.chessprogramming.org/Flipping_Mirroring_and_Rotating)
+*/
+#ifndef BITBOARD_H_
+#define BITBOARD_H_
+
+#include <stdint.h>
+
+
+// The lsb of every row.
+#define BITBOARD_LEFT_COLUMN    0x0101010101010101ULL
+// The msb of every row.
+#define BITBOARD_RIGHT_COLUMN   0x8080808080808080ULL
+// All of the pixels in the top row.
+#define BITBOARD_TOP_ROW        0x00000000000000FFULL
+// Every pixel turned on.
+#define BITBOARD_ALL            0xFFFFFFFFFFFFFFFFULL
+
+
+// Builds a bitboard from its 8 rows, starting with the top row.
+static constexpr uint64_t bitboardFromRows(uint8_t row0, uint8_t row1, uint8_t row2, uint8_t row3,
+                                           uint8_t row4, uint8_t row5, uint8_t row6, uint8_t row7)
+{
+    return (uint64_t)row0         | ((uint64_t)row1 << 8)  | ((uint64_t)row2 << 16) | ((uint64_t)row3 << 24) |
+           ((uint64_t)row4 << 32) | ((uint64_t)row5 << 40) | ((uint64_t)row6 << 48) | ((uint64_t)row7 << 56);
+}
+
+// Returns the 8 pixels of the specified row (0 - 7).
+static inline uint8_t bitboardRow(uint64_t bitboard, int row)
+{
+    return (uint8_t)(bitboard >> (row * 8));
+}
+
+// Returns a mask with all of the pixels in the specified row (0 - 7) turned on.
+static inline uint64_t bitboardRowMask(int row)
+{
+    return BITBOARD_TOP_ROW << (row * 8);
+}
+
+// Returns a mask with all of the pixels in the specified column (0 - 7) turned on.
+static inline uint64_t bitboardColumnMask(int column)
+{
+    return BITBOARD_LEFT_COLUMN << column;
+}
+
+// Returns a mask with all of the pixels turned on in each row whose bit is set in rows. Bit 0 is the top row (0) and
+// bit 7 is the bottom row (7). The multiply spreads the lower 7 bits out to the left column of their rows (bit 7 would
+// collide with bit 0 in it so it is moved on its own) and the second multiply fills in each of those rows.
+static inline uint64_t bitboardFromRowMask(uint8_t rows)
+{
+    uint64_t leftColumn = (((rows & 0x7FULL) * 0x0002040810204081ULL) & BITBOARD_LEFT_COLUMN) |
+                          ((uint64_t)(rows >> 7) << 56);
+    return leftColumn * 0xFF;
+}
+
+
+// Moves the image count (0 - 7) pixels to the left. Pixels pushed off the left edge are lost.
+static inline uint64_t bitboardShiftLeft(uint64_t bitboard, int count)
+{
+    return (bitboard >> count) & (BITBOARD_LEFT_COLUMN * (0xFF >> count));
+}
+
+// Moves the image count (0 - 7) pixels to the right. Pixels pushed off the right edge are lost.
+static inline uint64_t bitboardShiftRight(uint64_t bitboard, int count)
+{
+    return (bitboard << count) & (BITBOARD_LEFT_COLUMN * ((0xFF << count) & 0xFF));
+}
+
+// Moves the image count (0 - 7) pixels up. Pixels pushed off the top edge are lost.
+static inline uint64_t bitboardShiftUp(uint64_t bitboard, int count)
+{
+    return bitboard >> (count * 8);
+}
+
+// Moves the image count (0 - 7) pixels down. Pixels pushed off the bottom edge are lost.
+static inline uint64_t bitboardShiftDown(uint64_t bitboard, int count)
+{
+    return bitboard << (count * 8);
+}
+
+// Scrolls the image count (0 - 7) pixels to the left. Pixels pushed off the left edge wrap around to the right edge.
+static inline uint64_t bitboardScrollLeft(uint64_t bitboard, int count)
+{
+    count &= 7;
+    if (count == 0)
+        return bitboard;
+    return bitboardShiftLeft(bitboard, count) | bitboardShiftRight(bitboard, 8 - count);
+}
+
+// Scrolls the image count (0 - 7) pixels to the right. Pixels pushed off the right edge wrap around to the left edge.
+static inline uint64_t bitboardScrollRight(uint64_t bitboard, int count)
+{
+    return bitboardScrollLeft(bitboard, 8 - (count & 7));
+}
+
+// Scrolls the image count (0 - 7) pixels up. Pixels pushed off the top edge wrap around to the bottom edge.
+static inline uint64_t bitboardScrollUp(uint64_t bitboard, int count)
+{
+    count &= 7;
+    if (count == 0)
+        return bitboard;
+    return (bitboard >> (count * 8)) | (bitboard << (64 - count * 8));
+}
+
+// Scrolls the image count (0 - 7) pixels down. Pixels pushed off the bottom edge wrap around to the top edge.
+static inline uint64_t bitboardScrollDown(uint64_t bitboard, int count)
+{
+    return bitboardScrollUp(bitboard, 8 - (count & 7));
+}
+
+
+// Mirrors the image around its vertical axis so that the leftmost pixel of each row becomes the rightmost pixel.
+static inline uint64_t bitboardMirrorHorizontal(uint64_t bitboard)
+{
+    bitboard = ((bitboard >> 1) & 0x5555555555555555ULL) | ((bitboard & 0x5555555555555555ULL) << 1);
+    bitboard = ((bitboard >> 2) & 0x3333333333333333ULL) | ((bitboard & 0x3333333333333333ULL) << 2);
+    bitboard = ((bitboard >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((bitboard & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return bitboard;
+}
+
+// Mirrors the image around its horizontal axis so that the top row becomes the bottom row.
+static inline uint64_t bitboardMirrorVertical(uint64_t bitboard)
+{
+    return __builtin_bswap64(bitboard);
+}
+
+// Transposes the image around the diagonal running from the top left to the bottom right corner so that the pixel at
+// row r and column c ends up at row c and column r.
+static inline uint64_t bitboardTranspose(uint64_t bitboard)
+{
+    uint64_t t;
+
+    t = 0x0F0F0F0F00000000ULL & (bitboard ^ (bitboard << 28));
+    bitboard ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (bitboard ^ (bitboard << 14));
+    bitboard ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (bitboard ^ (bitboard << 7));
+    bitboard ^= t ^ (t >> 7);
+    return bitboard;
+}
+
+// Rotates the image 90 degrees clockwise.
+static inline uint64_t bitboardRotateClockwise(uint64_t bitboard)
+{
+    return bitboardMirrorHorizontal(bitboardTranspose(bitboard));
+}
+
+// Rotates the image 90 degrees counterclockwise.
+static inline uint64_t bitboardRotateCounterclockwise(uint64_t bitboard)
+{
+    return bitboardMirrorVertical(bitboardTranspose(bitboard));
+}
+
+
+// Converts the image to the row format used by the HT16K33's display RAM where each row is rotated right by 1 bit.
+static inline uint64_t bitboardToHt16k33(uint64_t bitboard)
+{
+    return ((bitboard >> 1) & ~BITBOARD_RIGHT_COLUMN) | ((bitboard << 7) & BITBOARD_RIGHT_COLUMN);
+}
+
+#endif // BITBOARD_H_
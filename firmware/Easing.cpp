@@ -0,0 +1,96 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <assert.h>
+#include "Easing.h"
+
+
+// Each curve is sampled at EASING_TABLE_SEGMENTS + 1 evenly spaced points from t = 0 to t = 1 and stored in Q15 so
+// that the overshooting curves still fit in 16 bits.
+#define EASING_TABLE_SHIFT      6
+#define EASING_TABLE_SEGMENTS   (1 << EASING_TABLE_SHIFT)
+#define EASING_TABLE_Q          15
+
+// The bits of the Q16 fraction which are below the table index and used to interpolate between two entries.
+#define EASING_WEIGHT_SHIFT     (EASING_FRACTION_SHIFT - EASING_TABLE_SHIFT)
+#define EASING_WEIGHT_MASK      ((1 << EASING_WEIGHT_SHIFT) - 1)
+
+
+// round(f(i / 64.0) * 32768) for each curve after EASE_LINEAR, which doesn't need a table.
+static const uint16_t g_easingTables[EASE_CURVE_COUNT - 1][EASING_TABLE_SEGMENTS + 1] =
+{
+    // EASE_IN: t^3
+    {
+        0,     0,     1,     3,     8,    16,    27,    43,    64,    91,   125,   166,   216,
+      275,   343,   422,   512,   614,   729,   857,  1000,  1158,  1331,  1521,  1728,  1953,
+     2197,  2460,  2744,  3049,  3375,  3724,  4096,  4492,  4913,  5359,  5832,  6332,  6859,
+     7415,  8000,  8615,  9261,  9938, 10648, 11391, 12167, 12978, 13824, 14706, 15625, 16581,
+    17576, 18610, 19683, 20797, 21952, 23149, 24389, 25672, 27000, 28373, 29791, 31256, 32768
+    },
+    // EASE_OUT: 1 - (1 - t)^3
+    {
+        0,  1512,  2977,  4395,  5768,  7096,  8379,  9619, 10816, 11971, 13085, 14158, 15192,
+    16187, 17143, 18062, 18944, 19790, 20601, 21377, 22120, 22830, 23507, 24153, 24768, 25353,
+    25909, 26436, 26936, 27409, 27855, 28276, 28672, 29044, 29393, 29719, 30024, 30308, 30571,
+    30815, 31040, 31247, 31437, 31610, 31768, 31911, 32039, 32154, 32256, 32346, 32425, 32493,
+    32552, 32602, 32643, 32677, 32704, 32725, 32741, 32752, 32760, 32765, 32767, 32768, 32768
+    },
+    // EASE_IN_OUT: t < 0.5 ? 4t^3 : 1 - (2 - 2t)^3 / 2
+    {
+        0,     0,     4,    14,    32,    62,   108,   172,   256,   364,   500,   666,   864,
+     1098,  1372,  1688,  2048,  2456,  2916,  3430,  4000,  4630,  5324,  6084,  6912,  7812,
+     8788,  9842, 10976, 12194, 13500, 14896, 16384, 17872, 19268, 20574, 21792, 22926, 23980,
+    24956, 25856, 26684, 27444, 28138, 28768, 29338, 29852, 30312, 30720, 31080, 31396, 31670,
+    31904, 32102, 32268, 32404, 32512, 32596, 32660, 32706, 32736, 32754, 32764, 32768, 32768
+    },
+    // EASE_OVERSHOOT: 1 + 2.70158(t - 1)^3 + 1.70158(t - 1)^2
+    {
+        0,  2356,  4612,  6770,  8831, 10798, 12672, 14456, 16152, 17762, 19287, 20731, 22094,
+    23379, 24587, 25722, 26785, 27778, 28702, 29561, 30356, 31088, 31761, 32376, 32936, 33441,
+    33895, 34298, 34654, 34965, 35231, 35456, 35642, 35789, 35902, 35980, 36027, 36045, 36035,
+    35999, 35941, 35860, 35761, 35644, 35511, 35366, 35209, 35043, 34870, 34691, 34509, 34327,
+    34145, 33966, 33792, 33624, 33466, 33319, 33185, 33066, 32964, 32881, 32820, 32781, 32768
+    },
+    // EASE_SPRING: 1 - e^(-6t) * cos(3 * pi * t)
+    {
+        0,  3255,  6772, 10408, 14042, 17574, 20923, 24028, 26845, 29344, 31510, 33341, 34843,
+    36031, 36925, 37552, 37938, 38115, 38114, 37964, 37697, 37338, 36914, 36447, 35959, 35465,
+    34981, 34519, 34087, 33692, 33339, 33031, 32768, 32550, 32375, 32241, 32145, 32082, 32049,
+    32042, 32056, 32087, 32132, 32187, 32249, 32314, 32381, 32447, 32511, 32571, 32626, 32675,
+    32719, 32757, 32788, 32814, 32834, 32848, 32858, 32864, 32866, 32865, 32862, 32856, 32768
+    }
+};
+
+
+uint32_t easeFraction(EasingCurve curve, uint32_t fraction)
+{
+    assert ( curve >= EASE_LINEAR && curve < EASE_CURVE_COUNT );
+
+    if (fraction >= EASING_FRACTION_ONE)
+        return EASING_FRACTION_ONE;
+    if (curve == EASE_LINEAR)
+        return fraction;
+
+    // Interpolate between the two table entries on either side of the fraction. The weighted sum is in
+    // Q(EASING_TABLE_Q + EASING_WEIGHT_SHIFT) which is shifted back down to Q16. Table entries are less than 2^16 so
+    // everything fits in 32 bits.
+    const uint16_t* pTable = g_easingTables[curve - 1];
+    uint32_t        index = fraction >> EASING_WEIGHT_SHIFT;
+    int32_t         weight = fraction & EASING_WEIGHT_MASK;
+    int32_t         start = pTable[index];
+    int32_t         end = pTable[index + 1];
+    int32_t         value = (start << EASING_WEIGHT_SHIFT) + (end - start) * weight;
+
+    return (uint32_t)value >> (EASING_TABLE_Q + EASING_WEIGHT_SHIFT - EASING_FRACTION_SHIFT);
+}
@@ -0,0 +1,57 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef EASING_H_
+#define EASING_H_
+
+#include <stdint.h>
+
+
+// Easing curves are evaluated on Q16 fixed point fractions of the way through a motion. EASING_FRACTION_ONE is the
+// end of the motion.
+#define EASING_FRACTION_SHIFT   16
+#define EASING_FRACTION_ONE     (1 << EASING_FRACTION_SHIFT)
+
+
+// The curves which key frames can use to ease from one key frame to the next. Every curve starts at 0 and ends at
+// exactly EASING_FRACTION_ONE but EASE_OVERSHOOT and EASE_SPRING go past the end along the way.
+enum EasingCurve
+{
+    // Constant speed for the whole motion.
+    EASE_LINEAR = 0,
+    // Starts slowly and accelerates (cubic).
+    EASE_IN,
+    // Starts quickly and decelerates (cubic).
+    EASE_OUT,
+    // Accelerates through the first half and decelerates through the second half (cubic).
+    EASE_IN_OUT,
+    // Decelerates past the end by about 10% and then settles back onto it.
+    EASE_OVERSHOOT,
+    // Overshoots by about 16% and then oscillates around the end, settling onto it.
+    EASE_SPRING,
+
+    EASE_CURVE_COUNT
+};
+
+
+// Returns how far along the given curve the motion should be at this point in time. The curves are stored as lookup
+// tables which are linearly interpolated between entries so this only takes a few multiplies and shifts.
+//  curve is the easing curve to be applied.
+//  fraction is the Q16 fraction of the motion's time which has elapsed (0 - EASING_FRACTION_ONE). Larger values are
+//           treated as EASING_FRACTION_ONE.
+//  Returns the Q16 fraction of the distance to be covered at this time. Can be larger than EASING_FRACTION_ONE for
+//  the curves which overshoot.
+uint32_t easeFraction(EasingCurve curve, uint32_t fraction);
+
+#endif // EASING_H_
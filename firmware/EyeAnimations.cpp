@@ -15,134 +15,549 @@
 /* Eye animations using Adafruit's 8x8 LED Matrix.
    Ported from Michal T Janyst's Led Eyes project (https://github.com/michaltj/LedEyes)
 */
+#include <string.h>
+#include "Bitboard.h"
 #include "EyeAnimations.h"
 #include "util.h"
 
-// The number of milliseconds to delay between eye blink frames.
-#define MILLISECONDS_FOR_BLINK_DELAY        40
+// The number of milliseconds between each step of the lids in an ExpressionAnimation.
+#define MILLISECONDS_FOR_LID_STEP           (60 / EYE_SCALE)
 
-// define eye ball without pupil
-static const uint8_t g_eyeBall[8] =
+// The number of I2C bytes it takes to redraw one display when FlashEyesAnimation flashes the eyes in software: a
+// command write followed by the 8 rows of the tile.
+#define FLASH_FRAME_WRITE_BYTES             (HT16K33_COMMAND_WRITE_BYTES + 8)
+
+// The mask of rows in EyeMatrices::m_visibleRows when none of them have been turned off.
+static const uint32_t g_allRows = (uint32_t)((1ULL << EYE_SIZE) - 1);
+
+
+// The following constexpr functions and templates are used by the compiler to generate g_pupilFrames at compile time
+// from the eye geometry set in EyeAnimations.h. The pixel tests are done in doubled coordinates so that the centers
+// of the pixels and of eyes with an even size both land on whole numbers.
+
+// Returns the square of value.
+static constexpr int square(int value)
+{
+    return value * value;
+}
+
+// Returns the pupil size in pixels for each of the EyeMatrices::PUPIL_SIZE_COUNT sizes.
+static constexpr int pupilSize(int sizeIndex)
+{
+    return EYE_PUPIL_MIN_SIZE + 2 * sizeIndex;
+}
+
+// Returns true if the pixel at column,row is part of the eye ball.
+static constexpr bool isEyeBallPixel(int column, int row)
+{
+    return square(2 * column + 1 - EYE_SIZE) + square(2 * row + 1 - EYE_SIZE) <= square(EYE_BALL_DIAMETER);
+}
+
+// Returns true if the pixel which is dx,dy (doubled) from the center of the pupil is part of the pupil.
+static constexpr bool isPupilOffset(int sizeIndex, int dx, int dy)
+{
+    return EYE_PUPIL_ROUND ? square(dx) + square(dy) <= square(pupilSize(sizeIndex)) :
+                             dx < pupilSize(sizeIndex) && dx > -pupilSize(sizeIndex) &&
+                             dy < pupilSize(sizeIndex) && dy > -pupilSize(sizeIndex);
+}
+
+// Returns true if the pixel at column,row is lit when the pupil is at x,y. The pupil is drawn by turning off the
+// pixels of the eye ball that it covers.
+static constexpr bool isEyePixel(int sizeIndex, int x, int y, int column, int row)
+{
+    return isEyeBallPixel(column, row) &&
+           !isPupilOffset(sizeIndex, 2 * column + 1 - (EYE_SIZE + 2 * x), 2 * row + 1 - (EYE_SIZE - 2 * y));
+}
+
+// Returns the bits of the 8x8 tile from bit onwards when the pupil is at x,y.
+static constexpr uint64_t pupilFrameTile(int sizeIndex, int x, int y, int tile, int bit = 0)
+{
+    return bit == 64 ? 0 :
+           ((uint64_t)isEyePixel(sizeIndex, x, y, (tile % EYE_TILES_ACROSS) * 8 + bit % 8,
+                                 (tile / EYE_TILES_ACROSS) * 8 + bit / 8) << bit) |
+           pupilFrameTile(sizeIndex, x, y, tile, bit + 1);
+}
+
+// Compile time list of the integers 0 to N - 1 used to expand the table initializers below. MakeIndexList<N>::Type is
+// IndexList<0, 1, ..., N - 1>.
+template <int... Indices>
+struct IndexList
+{
+};
+template <int N, int... Indices>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, Indices...>
+{
+};
+template <int... Indices>
+struct MakeIndexList<0, Indices...>
+{
+    typedef IndexList<Indices...> Type;
+};
+
+typedef MakeIndexList<EYE_TILE_COUNT>::Type                  TileIndices;
+typedef MakeIndexList<EyeMatrices::POSITION_COUNT>::Type     PositionIndices;
+typedef MakeIndexList<EyeMatrices::PUPIL_SIZE_COUNT>::Type   SizeIndices;
+typedef MakeIndexList<EyeMatrices::PUPIL_COUNT>::Type        PupilIndices;
+
+// Arrays can't be returned from functions so each level of the table is wrapped in a struct.
+struct PupilFrameRow
+{
+    EyeImage frames[EyeMatrices::POSITION_COUNT];
+};
+struct PupilFrameSize
+{
+    PupilFrameRow rows[EyeMatrices::POSITION_COUNT];
+};
+struct PupilFrameTable
+{
+    PupilFrameSize sizes[EyeMatrices::PUPIL_SIZE_COUNT];
+};
+
+// Returns the image of the eye with the pupil at x,y.
+template <int... Tiles>
+static constexpr EyeImage pupilFrame(IndexList<Tiles...>, int sizeIndex, int x, int y)
+{
+    return EyeImage { { pupilFrameTile(sizeIndex, x, y, Tiles)... } };
+}
+
+// Returns the images of the eye with the pupil at each x position along row y.
+template <int... Xs>
+static constexpr PupilFrameRow pupilFrameRow(IndexList<Xs...>, int sizeIndex, int y)
+{
+    return PupilFrameRow { { pupilFrame(TileIndices(), sizeIndex, Xs + EyeMatrices::MIN, y)... } };
+}
+
+// Returns the images of the eye with a pupil of the specified size at every position.
+template <int... Ys>
+static constexpr PupilFrameSize pupilFrameSize(IndexList<Ys...>, int sizeIndex)
+{
+    return PupilFrameSize { { pupilFrameRow(PositionIndices(), sizeIndex, Ys + EyeMatrices::MIN)... } };
+}
+
+// Returns the images of the eye for every pupil size and position.
+template <int... Sizes>
+static constexpr PupilFrameTable pupilFrameTable(IndexList<Sizes...>)
+{
+    return PupilFrameTable { { pupilFrameSize(PositionIndices(), Sizes)... } };
+}
+
+// The image of the eye with each size of pupil placed at every valid position, indexed by
+// .sizes[sizeIndex].rows[y - MIN].frames[x - MIN]. Generated at compile time and stored in FLASH so that displaying
+// the eyes, even while dilating the pupils, is just a table lookup.
+static constexpr PupilFrameTable g_pupilFrames = pupilFrameTable(SizeIndices());
+
+
+// Returns how much further down (doubled) the edge of an upper lid of the given shape reaches at the column which is u
+// (doubled) from the center of the eye. side is 0 for the left (even) eyes and 1 for the right (odd) eyes. The nose
+// is to the right of the left eyes.
+static constexpr int lidBend(int shape, int side, int u)
+{
+    return shape == EyeMatrices::LID_ROUND ? square(u) / EYE_SIZE :
+           shape == EyeMatrices::LID_ANGRY ? ((side ? -u : u) + EYE_SIZE - 1) / 2 :
+                                             ((side ? u : -u) + EYE_SIZE - 1) / 2;
+}
+
+// Returns true if the pixel at column,row is covered by an upper lid of the given shape which has been lowered to
+// position lid. Every shape of lid is completely open at LID_OPEN.
+static constexpr bool isUnderUpperLid(int shape, int side, int lid, int column, int row)
 {
-    0x3C, //B00111100,
-    0x7E, //B01111110,
-    0xFF, //B11111111,
-    0xFF, //B11111111,
-    0xFF, //B11111111,
-    0xFF, //B11111111,
-    0x7E, //B01111110,
-    0x3C  //B00111100
+    return lid > 0 && 2 * row + 1 < 2 * lid + lidBend(shape, side, 2 * column + 1 - EYE_SIZE);
+}
+
+// Returns true if the pixel at column,row isn't covered by the lid. The lower lids are an upside down round upper lid.
+static constexpr bool isLidPixelVisible(bool isUpper, int shape, int side, int lid, int column, int row)
+{
+    return isUpper ? !isUnderUpperLid(shape, side, lid, column, row) :
+                     !isUnderUpperLid(EyeMatrices::LID_ROUND, side, lid, column, EYE_SIZE - 1 - row);
+}
+
+// Returns the bits of the 8x8 tile of a lid mask from bit onwards.
+static constexpr uint64_t lidMaskTile(bool isUpper, int shape, int side, int lid, int tile, int bit = 0)
+{
+    return bit == 64 ? 0 :
+           ((uint64_t)isLidPixelVisible(isUpper, shape, side, lid, (tile % EYE_TILES_ACROSS) * 8 + bit % 8,
+                                        (tile / EYE_TILES_ACROSS) * 8 + bit / 8) << bit) |
+           lidMaskTile(isUpper, shape, side, lid, tile, bit + 1);
+}
+
+typedef MakeIndexList<EyeMatrices::LID_POSITION_COUNT>::Type LidIndices;
+
+struct LidMasks
+{
+    EyeImage lids[EyeMatrices::LID_POSITION_COUNT];
 };
 
-// The mask for turning off pixels to represent the pupil.
-static const uint8_t g_eyePupil = 0xE7; //B11100111;
+// Returns the mask of the pixels which aren't covered by a lid at position lid.
+template <int... Tiles>
+static constexpr EyeImage lidMask(IndexList<Tiles...>, bool isUpper, int shape, int side, int lid)
+{
+    return EyeImage { { lidMaskTile(isUpper, shape, side, lid, Tiles)... } };
+}
+
+// Returns the masks for a lid at every position.
+template <int... Lids>
+static constexpr LidMasks lidMasks(IndexList<Lids...>, bool isUpper, int shape, int side)
+{
+    return LidMasks { { lidMask(TileIndices(), isUpper, shape, side, Lids)... } };
+}
+
+// The masks of the pixels left uncovered by the upper lids, indexed by [side][shape].lids[position], and by the lower
+// lids, indexed by .lids[position]. They are ANDed together and then with the image of the eye to draw the lids over
+// it. Generated at compile time and stored in FLASH.
+static_assert(EyeMatrices::LID_SHAPE_COUNT == 3, "g_upperLidMasks needs to be updated for the new lid shapes.");
+static constexpr LidMasks g_upperLidMasks[2][EyeMatrices::LID_SHAPE_COUNT] =
+{
+    {
+        lidMasks(LidIndices(), true, EyeMatrices::LID_ROUND, 0),
+        lidMasks(LidIndices(), true, EyeMatrices::LID_ANGRY, 0),
+        lidMasks(LidIndices(), true, EyeMatrices::LID_SAD, 0)
+    },
+    {
+        lidMasks(LidIndices(), true, EyeMatrices::LID_ROUND, 1),
+        lidMasks(LidIndices(), true, EyeMatrices::LID_ANGRY, 1),
+        lidMasks(LidIndices(), true, EyeMatrices::LID_SAD, 1)
+    }
+};
+static constexpr LidMasks g_lowerLidMasks = lidMasks(LidIndices(), false, EyeMatrices::LID_ROUND, 0);
 
 
 
-EyeMatrices::EyeMatrices(I2C* pI2C, uint8_t leftEyeAddress /* = 0x70 */, uint8_t rightEyeAddress /* = 0x71 */) :
-    m_leftEye(pI2C),
-    m_rightEye(pI2C)
+EyeMatrices::EyeMatrices(IEyeDisplay* const* ppDisplays)
 {
-    // Initialize the LED eye matrices.
-    m_leftEye.begin(leftEyeAddress);
-    m_leftEye.setBrightness(0);
-    m_rightEye.begin(rightEyeAddress);
-    m_rightEye.setBrightness(0);
+    for (int display = 0 ; display < DISPLAY_COUNT ; display++)
+    {
+        m_pDisplays[display] = ppDisplays[display];
+    }
+    for (int pupil = 0 ; pupil < PUPIL_COUNT ; pupil++)
+    {
+        memset(&m_eyeCurrent[pupil], 0, sizeof(m_eyeCurrent[pupil]));
+        m_visibleRows[pupil] = g_allRows;
+        memset(&m_lidMask[pupil], 0xFF, sizeof(m_lidMask[pupil]));
+        m_lidShape[pupil] = LID_ROUND;
+        m_upperLid[pupil] = LID_OPEN;
+        m_lowerLid[pupil] = LID_OPEN;
+        m_eyePlaneCount[pupil] = 0;
+        m_currentPos[pupil].x = 0;
+        m_currentPos[pupil].y = 0;
+    }
+    m_pupilSize = 0;
+    m_isSoftPupils = false;
+    m_brightness = EYE_BRIGHTNESS_UNKNOWN;
+    m_dirtyEyes = 0;
+    m_updateDepth = 0;
     m_timer.start();
 }
 
-void EyeMatrices::displayEyes(const PupilPosition* pLeftPos, const PupilPosition* pRightPos)
+const EyeImage& EyeMatrices::getPupilFrame(const PupilPosition* pPos, int sizeIndex /* = 0 */)
 {
-    PupilPosition pos[PUPIL_COUNT];
-    pos[LEFT] = getValidPupilPosition(pLeftPos);
-    pos[RIGHT] = getValidPupilPosition(pRightPos);
+    assert ( sizeIndex >= 0 && sizeIndex < PUPIL_SIZE_COUNT );
+    PupilPosition pos = getValidPupilPosition(pPos);
+    return g_pupilFrames.sizes[sizeIndex].rows[pos.y - MIN].frames[pos.x - MIN];
+}
 
-    // calculate indices for pupil rows (perform offset Y)
-    int     row1[PUPIL_COUNT];
-    int     row2[PUPIL_COUNT];
-    uint8_t pupilRow[PUPIL_COUNT] = {g_eyePupil, g_eyePupil};
-    uint8_t pupilRow1[PUPIL_COUNT] = {0, 0};
-    uint8_t pupilRow2[PUPIL_COUNT] = {0, 0};
+EyeImage EyeMatrices::getEyeBallFrame()
+{
+    // Every size of pupil has been moved completely off of the eye ball when it is at the limits.
+    return g_pupilFrames.sizes[0].rows[POSITION_COUNT - 1].frames[POSITION_COUNT - 1];
+}
 
-    for (PupilEnum pupil = LEFT ; pupil <= RIGHT ; pupil = (PupilEnum)(pupil + 1))
+void EyeMatrices::displayEyes(const PupilPosition* pPositions)
+{
+    // Just draw the precomputed image for each pupil position.
+    for (int pupil = 0 ; pupil < PUPIL_COUNT ; pupil++)
     {
-        row1[pupil] = 3 - pos[pupil].y;
-        row2[pupil] = 4 - pos[pupil].y;
+        PupilPosition   pos = getValidPupilPosition(&pPositions[pupil]);
+        const EyeImage& frame = getPupilFrame(&pos, m_pupilSize);
+        if (m_isSoftPupils)
+            drawSoftPupil((PupilEnum)pupil, frame);
+        else
+            drawEye((PupilEnum)pupil, frame);
+
+        // update current X and Y
+        m_currentPos[pupil] = pos;
+    }
+
+    writeDisplays();
+}
 
-        // define pupil row
-        int x = pos[pupil].x;
-        if (x > 0)
-            pupilRow[pupil] = (g_eyePupil << x) | ((1 << x) - 1);
-        else if (x < 0)
-            pupilRow[pupil] = ((int8_t)g_eyePupil >> -x);
+void EyeMatrices::setPupilSize(int sizeIndex)
+{
+    if (sizeIndex < 0)
+        sizeIndex = 0;
+    if (sizeIndex >= PUPIL_SIZE_COUNT)
+        sizeIndex = PUPIL_SIZE_COUNT - 1;
+    m_pupilSize = sizeIndex;
+
+    // Redraw the pupils at their current positions with the new size.
+    displayEyes(m_currentPos);
+}
 
-        // pupil row cannot have 1s where eyeBall has 0s
-        if (row1[pupil] >= 0 && row1[pupil] <= 7)
-            pupilRow1[pupil] = pupilRow[pupil] & g_eyeBall[row1[pupil]];
-        if (row2[pupil] >= 0 && row2[pupil] <= 7)
-            pupilRow2[pupil] = pupilRow[pupil] & g_eyeBall[row2[pupil]];
+void EyeMatrices::drawEye(PupilEnum pupil, const EyeImage& image)
+{
+    assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+    // Eyes which aren't changing don't need to be rendered or sent to their matrix again.
+    if (memcmp(&m_eyeCurrent[pupil], &image, sizeof(image)) == 0 &&
+        m_visibleRows[pupil] == g_allRows && m_eyePlaneCount[pupil] == 0)
+        return;
+    m_eyeCurrent[pupil] = image;
+    m_visibleRows[pupil] = g_allRows;
+    m_eyePlaneCount[pupil] = 0;
+    renderEye(pupil);
+}
 
-        // display on LCD matrix, update to eyeCurrent
-        for (int r = 0; r < 8 ; r++)
+void EyeMatrices::drawEyeGrayscale(PupilEnum pupil, const EyeImage* pPlanes, int planeCount)
+{
+    assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+    assert ( planeCount >= 1 && planeCount <= EYE_DISPLAY_MAX_PLANES );
+    // Eyes which aren't changing don't need to be rendered or sent to their matrix again.
+    if (m_eyePlaneCount[pupil] == planeCount && m_visibleRows[pupil] == g_allRows &&
+        memcmp(m_eyePlanes[pupil], pPlanes, planeCount * sizeof(*pPlanes)) == 0)
+        return;
+    for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+    {
+        uint64_t litPixels = 0;
+        for (int plane = 0 ; plane < planeCount ; plane++)
         {
-            if (r == row1[pupil])
-            {
-                drawRow(pupil, r, pupilRow1[pupil]);
-                m_eyeCurrent[pupil][r] = pupilRow1[pupil];
-            }
-            else if (r == row2[pupil])
-            {
-                drawRow(pupil, r, pupilRow2[pupil]);
-                m_eyeCurrent[pupil][r] = pupilRow2[pupil];
-            }
-            else
+            m_eyePlanes[pupil][plane].tiles[tile] = pPlanes[plane].tiles[tile];
+            litPixels |= pPlanes[plane].tiles[tile];
+        }
+        m_eyeCurrent[pupil].tiles[tile] = litPixels;
+    }
+    m_visibleRows[pupil] = g_allRows;
+    m_eyePlaneCount[pupil] = planeCount;
+    renderEye(pupil);
+}
+
+// Returns the pixels which are directly above, below, left or right of a pixel set in image, including those whose
+// neighbour is in the next tile over.
+static EyeImage neighbouringPixels(const EyeImage& image)
+{
+    EyeImage neighbours;
+    for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+    {
+        int      tileColumn = tile % EYE_TILES_ACROSS;
+        int      tileRow = tile / EYE_TILES_ACROSS;
+        uint64_t pixels = image.tiles[tile];
+        uint64_t result = bitboardShiftLeft(pixels, 1) | bitboardShiftRight(pixels, 1) |
+                          bitboardShiftUp(pixels, 1) | bitboardShiftDown(pixels, 1);
+        if (tileColumn > 0)
+            result |= (image.tiles[tile - 1] & BITBOARD_RIGHT_COLUMN) >> 7;
+        if (tileColumn < EYE_TILES_ACROSS - 1)
+            result |= (image.tiles[tile + 1] & BITBOARD_LEFT_COLUMN) << 7;
+        if (tileRow > 0)
+            result |= image.tiles[tile - EYE_TILES_ACROSS] >> 56;
+        if (tileRow < EYE_TILES_ACROSS - 1)
+            result |= image.tiles[tile + EYE_TILES_ACROSS] << 56;
+        neighbours.tiles[tile] = result;
+    }
+    return neighbours;
+}
+
+void EyeMatrices::drawSoftPupil(PupilEnum pupil, const EyeImage& frame)
+{
+    // The pupil is the part of the eye ball which is turned off in the frame and its rim is the lit pixels around it.
+    EyeImage eyeBall = getEyeBallFrame();
+    EyeImage pupilPixels;
+    for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+    {
+        pupilPixels.tiles[tile] = eyeBall.tiles[tile] & ~frame.tiles[tile];
+    }
+    EyeImage rim = neighbouringPixels(pupilPixels);
+
+    // The rim only has the most significant plane set so that it is shown at about half brightness by displays which
+    // support grayscale and at full brightness by those which don't.
+    EyeImage planes[EYE_DISPLAY_MAX_PLANES];
+    for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+    {
+        for (int plane = 0 ; plane < EYE_DISPLAY_MAX_PLANES - 1 ; plane++)
+        {
+            planes[plane].tiles[tile] = frame.tiles[tile] & ~rim.tiles[tile];
+        }
+        planes[EYE_DISPLAY_MAX_PLANES - 1].tiles[tile] = frame.tiles[tile];
+    }
+    drawEyeGrayscale(pupil, planes, EYE_DISPLAY_MAX_PLANES);
+}
+
+void EyeMatrices::drawRow(PupilEnum pupil, int row, uint32_t rowData)
+{
+    assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+    assert ( row >= 0 && row < EYE_SIZE );
+    uint64_t  rowMask = bitboardRowMask(row % 8);
+    uint64_t* pTiles = &m_eyeCurrent[pupil].tiles[(row / 8) * EYE_TILES_ACROSS];
+    for (int tileColumn = 0 ; tileColumn < EYE_TILES_ACROSS ; tileColumn++)
+    {
+        uint8_t tileRowData = (uint8_t)(rowData >> (tileColumn * 8));
+        pTiles[tileColumn] = (pTiles[tileColumn] & ~rowMask) | ((uint64_t)tileRowData << ((row % 8) * 8));
+    }
+    // Drawing rows switches the eye back to a monochrome image.
+    m_eyePlaneCount[pupil] = 0;
+    renderEye(pupil);
+}
+
+void EyeMatrices::setLids(PupilEnum pupil, LidShape shape, int upperLid, int lowerLid)
+{
+    assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+    assert ( shape >= 0 && shape < LID_SHAPE_COUNT );
+    upperLid = upperLid < LID_OPEN ? LID_OPEN : upperLid > LID_CLOSED ? LID_CLOSED : upperLid;
+    lowerLid = lowerLid < LID_OPEN ? LID_OPEN : lowerLid > LID_CLOSED ? LID_CLOSED : lowerLid;
+    if (shape == m_lidShape[pupil] && upperLid == m_upperLid[pupil] && lowerLid == m_lowerLid[pupil])
+        return;
+    m_lidShape[pupil] = shape;
+    m_upperLid[pupil] = upperLid;
+    m_lowerLid[pupil] = lowerLid;
+
+    const EyeImage& upperMask = g_upperLidMasks[pupil & 1][shape].lids[upperLid];
+    const EyeImage& lowerMask = g_lowerLidMasks.lids[lowerLid];
+    for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+    {
+        m_lidMask[pupil].tiles[tile] = upperMask.tiles[tile] & lowerMask.tiles[tile];
+        eye(pupil, tile)->setLidMask(~m_lidMask[pupil].tiles[tile]);
+    }
+    renderEye(pupil);
+}
+
+void EyeMatrices::turnRowOffTemporarily(PupilEnum pupil, int row)
+{
+    assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+    assert ( row >= 0 && row < EYE_SIZE );
+    m_visibleRows[pupil] &= ~(1 << row);
+    renderEye(pupil);
+}
+
+void EyeMatrices::restoreRow(PupilEnum pupil, int row)
+{
+    assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+    assert ( row >= 0 && row < EYE_SIZE );
+    m_visibleRows[pupil] |= 1 << row;
+    renderEye(pupil);
+}
+
+void EyeMatrices::renderEye(PupilEnum pupil)
+{
+    int planeCount = m_eyePlaneCount[pupil];
+    for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+    {
+        uint64_t visible = bitboardFromRowMask((uint8_t)(m_visibleRows[pupil] >> ((tile / EYE_TILES_ACROSS) * 8))) &
+                           m_lidMask[pupil].tiles[tile];
+        if (planeCount == 0)
+        {
+            eye(pupil, tile)->setFrame(m_eyeCurrent[pupil].tiles[tile] & visible);
+        }
+        else
+        {
+            uint64_t planes[EYE_DISPLAY_MAX_PLANES];
+            for (int plane = 0 ; plane < planeCount ; plane++)
             {
-                drawRow(pupil, r, g_eyeBall[r]);
-                m_eyeCurrent[pupil][r] = g_eyeBall[r];
+                planes[plane] = m_eyePlanes[pupil][plane].tiles[tile] & visible;
             }
+            eye(pupil, tile)->setGrayscaleFrame(planes, planeCount);
         }
     }
+    m_dirtyEyes |= 1 << pupil;
+}
 
-    // update current X and Y
-    m_currentPos[LEFT] = pos[LEFT];
-    m_currentPos[RIGHT] = pos[RIGHT];
+void EyeMatrices::writeDisplays()
+{
+    // Leave the eyes dirty until endUpdate() if in the middle of an update.
+    if (m_updateDepth > 0)
+        return;
+
+    // Only visit the eyes which have actually been drawn into so that the cost of each frame depends on the number
+    // of eyes which changed rather than the total number of eyes.
+    uint32_t dirtyEyes = m_dirtyEyes;
+    m_dirtyEyes = 0;
+    while (dirtyEyes)
+    {
+        int pupil = __builtin_ctz(dirtyEyes);
+        dirtyEyes &= dirtyEyes - 1;
+        for (int tile = 0 ; tile < EYE_TILE_COUNT ; tile++)
+        {
+            eye((PupilEnum)pupil, tile)->flush();
+        }
+    }
+}
 
+void EyeMatrices::setBrightness(uint8_t brightness)
+{
+    m_brightness = brightness;
+
+    for (int display = 0 ; display < DISPLAY_COUNT ; display++)
+    {
+        m_pDisplays[display]->setBrightness(brightness);
+    }
+
+    // Some backends only send the brightness when flushed.
+    m_dirtyEyes = ALL_EYES_MASK;
     writeDisplays();
 }
 
-void EyeMatrices::turnRowOffTemporarily(PupilEnum pupil, int row)
+bool EyeMatrices::setBlinkRate(uint8_t rate)
 {
-    Adafruit_8x8matrix* pEye = eye(pupil);
-    assert ( row >= 0 && row < 8 );
-    pEye->drawRow(row, 0);
+    for (int display = 0 ; display < DISPLAY_COUNT ; display++)
+    {
+        if (!m_pDisplays[display]->setBlinkRate(rate))
+        {
+            // Stop any of the displays which did start blinking so that they don't get out of step with the software
+            // blink.
+            for (int i = 0 ; i < display ; i++)
+            {
+                m_pDisplays[i]->setBlinkRate(HT16K33_BLINK_OFF);
+            }
+            return false;
+        }
+    }
+    return true;
 }
 
-void EyeMatrices::restoreRow(PupilEnum pupil, int row)
+
+
+void EyeAnimationTracks::run()
 {
-    Adafruit_8x8matrix* pEye = eye(pupil);
-    assert ( row >= 0 && row < 8 );
-    pEye->drawRow(row, m_eyeCurrent[pupil][row]);
+    m_pEyes->beginUpdate();
+    for (int track = 0 ; track < EYE_ANIMATION_TRACK_COUNT ; track++)
+    {
+        if (!isDone(track))
+            m_pAnimations[track]->run();
+    }
+    m_pEyes->endUpdate();
+}
+
+bool EyeAnimationTracks::isDone()
+{
+    for (int track = 0 ; track < EYE_ANIMATION_TRACK_COUNT ; track++)
+    {
+        if (!isDone(track))
+            return false;
+    }
+    return true;
 }
 
 
 
-void BlinkAnimation::start(bool leftBlink /* = true */, bool rightBlink /* = true */)
+void BlinkAnimation::startEyes(uint32_t eyeMask, uint32_t delay /* = 0 */)
 {
-    m_leftBlink = leftBlink;
-    m_rightBlink = rightBlink;
+    m_eyeMask = eyeMask & EyeMatrices::ALL_EYES_MASK;
 
-    // Nothing to do if not being asked to blink either eye.
-    if (!m_leftBlink && !m_rightBlink)
+    // Nothing to do if not being asked to blink any eyes.
+    if (m_eyeMask == 0)
     {
         m_isDone = true;
         return;
     }
 
+    // Remember where the lids were so that any expression the eyes had is restored after the blink.
+    for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
+    {
+        m_restUpperLid[pupil] = m_pEyes->getUpperLid((EyeMatrices::PupilEnum)pupil);
+        m_restLowerLid[pupil] = m_pEyes->getLowerLid((EyeMatrices::PupilEnum)pupil);
+    }
+
     // Start the eye(s) closing on the next call to run().
     m_isDone = false;
     m_state = EYE_CLOSING;
-    m_index = 0;
-    startDelay(0);
+    m_lid = EyeMatrices::LID_OPEN;
+    startDelay(delay);
+    m_phaseStart = m_startTime + m_desiredDelay;
 }
 
 void BlinkAnimation::run()
@@ -151,50 +566,28 @@ void BlinkAnimation::run()
     if (!isDelayDone())
         return;
 
+    uint32_t elapsed = m_pEyes->getCurrentTime() - m_phaseStart;
+    int      lidSteps = (int)(elapsed * EyeMatrices::LID_CLOSED / MILLISECONDS_FOR_BLINK_CLOSE);
+    int      lid = m_lid;
+    State    prevState = m_state;
     switch (m_state)
     {
     case EYE_CLOSING:
-        if (m_leftBlink)
-        {
-            m_pEyes->turnRowOffTemporarily(EyeMatrices::LEFT, m_index);
-            m_pEyes->turnRowOffTemporarily(EyeMatrices::LEFT, 7-m_index);
-        }
-        if (m_rightBlink)
-        {
-            m_pEyes->turnRowOffTemporarily(EyeMatrices::RIGHT, m_index);
-            m_pEyes->turnRowOffTemporarily(EyeMatrices::RIGHT, 7-m_index);
-        }
-        m_pEyes->writeDisplays();
-
-        startDelay(MILLISECONDS_FOR_BLINK_DELAY);
-
-        m_index++;
-        if (m_index > 3)
+        // The lids start moving on the very first frame and are closed once MILLISECONDS_FOR_BLINK_CLOSE is up.
+        lid = lidSteps + 1;
+        if (lid >= EyeMatrices::LID_CLOSED)
         {
+            // Hold the lids closed for one frame before they start opening.
+            lid = EyeMatrices::LID_CLOSED;
             m_state = EYE_OPENING;
-            m_index = 3;
         }
         break;
     case EYE_OPENING:
-        if (m_leftBlink)
-        {
-            m_pEyes->restoreRow(EyeMatrices::LEFT, m_index);
-            m_pEyes->restoreRow(EyeMatrices::LEFT, 7-m_index);
-        }
-        if (m_rightBlink)
-        {
-            m_pEyes->restoreRow(EyeMatrices::RIGHT, m_index);
-            m_pEyes->restoreRow(EyeMatrices::RIGHT, 7-m_index);
-        }
-        m_pEyes->writeDisplays();
-
-        startDelay(MILLISECONDS_FOR_BLINK_DELAY);
-
-        m_index--;
-        if (m_index < 0)
+        lid = EyeMatrices::LID_CLOSED - 1 - lidSteps;
+        if (lid <= EyeMatrices::LID_OPEN)
         {
+            lid = EyeMatrices::LID_OPEN;
             m_state = DONE;
-            m_index = 0;
             m_isDone = true;
         }
         break;
@@ -202,12 +595,39 @@ void BlinkAnimation::run()
         assert ( m_state != DONE );
         break;
     }
+
+    // Only draw the lids when they have moved since the last frame.
+    if (lid != m_lid)
+    {
+        for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
+        {
+            if (m_eyeMask & (1 << pupil))
+            {
+                EyeMatrices::PupilEnum eye = (EyeMatrices::PupilEnum)pupil;
+                m_pEyes->setLids(eye, m_pEyes->getLidShape(eye),
+                                 lid > m_restUpperLid[pupil] ? lid : m_restUpperLid[pupil],
+                                 lid > m_restLowerLid[pupil] ? lid : m_restLowerLid[pupil]);
+            }
+        }
+        m_pEyes->writeDisplays();
+        m_lid = lid;
+    }
+
+    scheduleNextDelay(m_frameDelay);
+
+    // Time the next phase from when its first step is due rather than from now. If this step ran late, now plus
+    // m_frameDelay would be after that step and elapsed would wrap around when it runs.
+    if (m_state != prevState)
+        m_phaseStart = m_startTime + m_desiredDelay;
 }
 
 
 
-void PupilAnimation::start(const PupilKeyFrame* pKeyFrames, size_t keyFrameCount)
+void PupilAnimation::start(const PupilKeyFrame* pKeyFrames, size_t keyFrameCount,
+                           uint32_t eyeMask /* = EyeMatrices::ALL_EYES_MASK */)
 {
+    m_eyeMask = eyeMask;
+
     // Just return if nothing to do.
     if (keyFrameCount == 0)
     {
@@ -228,25 +648,25 @@ void PupilAnimation::startNextFrame()
 {
     assert ( m_pCurrKeyFrame < m_pLastKeyFrame );
 
-    // Start each eye's pupil out at its current position.
-    m_startPos[EyeMatrices::LEFT] = m_pEyes->getPupilPos(EyeMatrices::LEFT);
-    m_startPos[EyeMatrices::RIGHT] = m_pEyes->getPupilPos(EyeMatrices::RIGHT);
-
-    // Target positions for each eye's pupil after fixup for out of range offsets.
+    PupilPosition startPos[EyeMatrices::PUPIL_COUNT];
     PupilPosition newPos[EyeMatrices::PUPIL_COUNT];
-    newPos[EyeMatrices::LEFT] = EyeMatrices::getValidPupilPosition(&m_pCurrKeyFrame->left);
-    newPos[EyeMatrices::RIGHT] = EyeMatrices::getValidPupilPosition(&m_pCurrKeyFrame->right);
-
-    // The final step count for this animation will be the largest pixel traversal along any axis for either eye.
     PupilPosition steps[EyeMatrices::PUPIL_COUNT];
     int           perEyeSteps[EyeMatrices::PUPIL_COUNT];
-    for (EyeMatrices::PupilEnum pupil = EyeMatrices::LEFT ;
-         pupil <= EyeMatrices::RIGHT ;
-         pupil = (EyeMatrices::PupilEnum)(pupil + 1))
+    for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
     {
+        // Start each eye's pupil out at its current position.
+        startPos[pupil] = m_pEyes->getPupilPos((EyeMatrices::PupilEnum)pupil);
+
+        // Target positions for each eye's pupil after fixup for out of range offsets. Eyes which aren't being animated
+        // just stay where they are.
+        if (m_eyeMask & (1 << pupil))
+            newPos[pupil] = EyeMatrices::getValidPupilPosition(&m_pCurrKeyFrame->pupils[pupil]);
+        else
+            newPos[pupil] = startPos[pupil];
+
         // Determine how many pixels the pupil has to traverse along each axis.
-        steps[pupil].x = abs(m_startPos[pupil].x - newPos[pupil].x);
-        steps[pupil].y = abs(m_startPos[pupil].y - newPos[pupil].y);
+        steps[pupil].x = abs(startPos[pupil].x - newPos[pupil].x);
+        steps[pupil].y = abs(startPos[pupil].y - newPos[pupil].y);
 
         // The total number of steps to execute for the animation is determined by whether we need to interpolate or not.
         if (m_pCurrKeyFrame->interpolate)
@@ -260,29 +680,36 @@ void PupilAnimation::startNextFrame()
             perEyeSteps[pupil] = 1;
         }
     }
-    m_steps = (perEyeSteps[EyeMatrices::LEFT] > perEyeSteps[EyeMatrices::RIGHT]) ?
-              perEyeSteps[EyeMatrices::LEFT] : perEyeSteps[EyeMatrices::RIGHT];
+
+    // The final step count for this animation will be the largest pixel traversal along any axis for any eye.
+    m_steps = perEyeSteps[0];
+    for (int pupil = 1 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
+    {
+        if (perEyeSteps[pupil] > m_steps)
+            m_steps = perEyeSteps[pupil];
+    }
+
+    // Eased motions take more, shorter, steps so that the pupil can speed up and slow down smoothly. The only division
+    // is done here, once per key frame, to find how far through the motion each step is.
+    m_easing = m_pCurrKeyFrame->interpolate ? m_pCurrKeyFrame->easing : EASE_LINEAR;
+    m_easingFraction = 0;
+    m_easingError = 0;
+    if (m_easing != EASE_LINEAR && m_steps > 0)
+    {
+        m_steps *= PUPIL_EASING_STEPS_PER_PIXEL;
+        m_easingFractionStep = EASING_FRACTION_ONE / m_steps;
+        m_easingRemainder = EASING_FRACTION_ONE % m_steps;
+    }
 
     // Calculate the rest of the animation parameters now that the number of steps has been determined.
-    for (EyeMatrices::PupilEnum pupil = EyeMatrices::LEFT ;
-         pupil <= EyeMatrices::RIGHT ;
-         pupil = (EyeMatrices::PupilEnum)(pupil + 1))
+    for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
     {
-        // Evaluate how much each axis should translate per step (floating point).
-        m_changeX[pupil] = (float)steps[pupil].x / (float)m_steps;
-        if (newPos[pupil].x < m_startPos[pupil].x)
-            m_changeX[pupil] = -m_changeX[pupil];
-        m_changeY[pupil] = (float)steps[pupil].y / (float)m_steps;
-        if (newPos[pupil].y < m_startPos[pupil].y)
-            m_changeY[pupil] = -m_changeY[pupil];
+        startAxis(&m_axisX[pupil], startPos[pupil].x, newPos[pupil].x);
+        startAxis(&m_axisY[pupil], startPos[pupil].y, newPos[pupil].y);
     }
 
     // Start at the first step.
     m_index = 1;
-
-    // Remember the step delays for the current frame to use in run() method.
-    m_frameDelay = m_pCurrKeyFrame->frameDelayStart;
-    m_frameDelayStep = m_pCurrKeyFrame->frameDelayStep;
 }
 
 void PupilAnimation::run()
@@ -292,9 +719,10 @@ void PupilAnimation::run()
         return;
 
     assert ( m_index <= m_steps + 1 );
-    if (m_index > m_steps)
+    while (m_index > m_steps)
     {
-        // Have animated to the current key frame so advance to the next one.
+        // Have animated to the current key frame so advance to the next one. Interpolated key frames which don't move
+        // any of the pupils have no steps so they are skipped over, the same as when the first key frame doesn't.
         m_pCurrKeyFrame++;
         if (m_pCurrKeyFrame >= m_pLastKeyFrame)
         {
@@ -305,342 +733,507 @@ void PupilAnimation::run()
         startNextFrame();
     }
 
+    if (m_easing != EASE_LINEAR)
+    {
+        // Advance to how far through the motion this step is, carrying the remainder so that the last step is exactly
+        // at the end.
+        m_easingFraction += m_easingFractionStep;
+        m_easingError += m_easingRemainder;
+        if (m_easingError >= (uint32_t)m_steps)
+        {
+            m_easingError -= m_steps;
+            m_easingFraction++;
+        }
+    }
+
     PupilPosition pupilPos[EyeMatrices::PUPIL_COUNT];
-    for (EyeMatrices::PupilEnum pupil = EyeMatrices::LEFT ;
-         pupil <= EyeMatrices::RIGHT ;
-         pupil = (EyeMatrices::PupilEnum)(pupil + 1))
+    for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
     {
-        pupilPos[pupil].x = m_startPos[pupil].x + round(m_changeX[pupil] * (float)m_index);
-        pupilPos[pupil].y = m_startPos[pupil].y + round(m_changeY[pupil] * (float)m_index);
+        if ((m_eyeMask & (1 << pupil)) == 0)
+        {
+            // Leave the pupils which aren't part of this animation wherever another track may have moved them.
+            pupilPos[pupil] = m_pEyes->getPupilPos((EyeMatrices::PupilEnum)pupil);
+            continue;
+        }
+        if (m_easing == EASE_LINEAR)
+        {
+            pupilPos[pupil].x = stepAxis(&m_axisX[pupil]);
+            pupilPos[pupil].y = stepAxis(&m_axisY[pupil]);
+        }
+        else
+        {
+            pupilPos[pupil].x = easeAxis(&m_axisX[pupil]);
+            pupilPos[pupil].y = easeAxis(&m_axisY[pupil]);
+        }
     }
-    m_pEyes->displayEyes(&pupilPos[EyeMatrices::LEFT], &pupilPos[EyeMatrices::RIGHT]);
+    m_pEyes->displayEyes(pupilPos);
 
-    startDelay(m_frameDelay);
-    m_frameDelay += m_frameDelayStep;
+    scheduleNextDelay(calculateStepDelay());
 
     m_index++;
 }
 
+void PupilAnimation::startAxis(AxisStepper* pAxis, int startPos, int endPos)
+{
+    // Each step moves the pupil distance/m_steps pixels along this axis. Rather than tracking that fraction in floating
+    // point, everything is scaled up by 2 * m_steps so that the ideal position is an integer and rounding it to the
+    // nearest pixel (halves away from the start) is just a comparison.
+    pAxis->pos = startPos;
+    pAxis->direction = (endPos < startPos) ? -1 : 1;
+    pAxis->increment = 2 * abs(endPos - startPos);
+    pAxis->error = m_steps;
+    pAxis->start = startPos;
+    pAxis->distance = endPos - startPos;
+}
+
+int PupilAnimation::stepAxis(AxisStepper* pAxis)
+{
+    // When interpolating, the distance along either axis is never more than m_steps so this loop moves the pupil by
+    // at most 1 pixel. Key frames which aren't interpolated have a single step which jumps the whole distance.
+    assert ( m_steps > 0 );
+    pAxis->error += pAxis->increment;
+    while (pAxis->error >= 2 * m_steps)
+    {
+        pAxis->error -= 2 * m_steps;
+        pAxis->pos += pAxis->direction;
+    }
+    return pAxis->pos;
+}
+
+int PupilAnimation::easeAxis(const AxisStepper* pAxis)
+{
+    // Scale the distance by the eased Q16 fraction and round to the nearest pixel, halves away from the start like
+    // stepAxis(). The distance is less than 2 * EyeMatrices::MAX and the eased fraction less than 2 so it fits.
+    int32_t change = pAxis->distance * (int32_t)easeFraction(m_easing, m_easingFraction);
+    if (change >= 0)
+        return pAxis->start + ((change + EASING_FRACTION_ONE / 2) >> EASING_FRACTION_SHIFT);
+    else
+        return pAxis->start - ((-change + EASING_FRACTION_ONE / 2) >> EASING_FRACTION_SHIFT);
+}
+
+uint32_t PupilAnimation::calculateStepDelay()
+{
+    uint32_t delayStart = m_pCurrKeyFrame->frameDelayStart;
+
+    // Eased motions share each pixel's delay between its steps. Working out where this step ends on the whole motion's
+    // timeline, rather than rounding each step on its own, keeps the motion's total time the same as a linear one.
+    if (m_easing != EASE_LINEAR)
+    {
+        uint32_t prevEnd = (delayStart * (m_index - 1)) >> PUPIL_EASING_STEP_SHIFT;
+        uint32_t end = (delayStart * m_index) >> PUPIL_EASING_STEP_SHIFT;
+        return end - prevEnd;
+    }
+
+    // Linear motions can speed up or slow down by frameDelayStep each step. Calculate the delay for this step directly
+    // so that a negative frameDelayStep stops at no delay rather than wrapping around.
+    int32_t delay = (int32_t)delayStart + m_pCurrKeyFrame->frameDelayStep * (m_index - 1);
+    return (delay > 0) ? delay : 0;
+}
+
 
 
-void MoveEyeAnimation::start(int newX, int newY, uint32_t stepDelay)
+void MoveEyeAnimation::start(int newX, int newY, uint32_t stepDelay,
+                             uint32_t eyeMask /* = EyeMatrices::ALL_EYES_MASK */,
+                             EasingCurve easing /* = EASE_LINEAR */)
 {
-    m_keyFrames[0].left.x = m_keyFrames[0].right.x = newX;
-    m_keyFrames[0].left.y = m_keyFrames[0].right.y = newY;
+    // The caller's position is used as is, without scaling it for larger eyes.
+    for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
+    {
+        m_keyFrames[0].pupils[pupil].x = newX;
+        m_keyFrames[0].pupils[pupil].y = newY;
+    }
     m_keyFrames[0].frameDelayStart = stepDelay;
     m_keyFrames[0].frameDelayStep = 0;
     m_keyFrames[0].interpolate = true;
+    m_keyFrames[0].easing = easing;
 
-    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames));
+    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames), eyeMask);
 }
 
 
 
-void CrossEyesAnimation::start()
+// Returns a pupil key frame with every left (even) eye at leftX,leftY and every right (odd) eye at rightX,rightY. The
+// positions are for the original 8x8 eyes and are scaled up by EYE_SCALE to cover the same part of larger eyes.
+template <int... Pupils>
+static constexpr PupilKeyFrame pupilsKeyFrame(IndexList<Pupils...>, int leftX, int leftY, int rightX, int rightY,
+                                              uint32_t frameDelayStart, bool interpolate, EasingCurve easing)
+{
+    return PupilKeyFrame { { PupilPosition { ((Pupils & 1) ? rightX : leftX) * EYE_SCALE,
+                                             ((Pupils & 1) ? rightY : leftY) * EYE_SCALE }... },
+                           frameDelayStart, 0, interpolate, easing };
+}
+
+static constexpr PupilKeyFrame pupilsKeyFrame(int leftX, int leftY, int rightX, int rightY,
+                                              uint32_t frameDelayStart, bool interpolate,
+                                              EasingCurve easing = EASE_LINEAR)
+{
+    return pupilsKeyFrame(PupilIndices(), leftX, leftY, rightX, rightY, frameDelayStart, interpolate, easing);
+}
+
+// Returns a pupil key frame with the pupils of all eyes at the same location (scaled by EYE_SCALE).
+static constexpr PupilKeyFrame allPupilsKeyFrame(int x, int y, uint32_t frameDelayStart, bool interpolate,
+                                                 EasingCurve easing = EASE_LINEAR)
+{
+    return pupilsKeyFrame(x, y, x, y, frameDelayStart, interpolate, easing);
+}
+
+// Key frame tables whose length depends on an iteration count are generated a frame at a time into one of these.
+template <int FRAME_COUNT>
+struct PupilKeyFrameTable
+{
+    PupilKeyFrame frames[FRAME_COUNT];
+};
+
+
+
+// The canned pupil animations below are all generated at compile time and stored in FLASH so starting one of them
+// just points the PupilAnimation at its table.
+static constexpr PupilKeyFrame g_crossEyesKeyFrames[] =
 {
     // Move eyes to center position first.
-    m_keyFrames[0].left.x = m_keyFrames[0].right.x = 0;
-    m_keyFrames[0].left.y = m_keyFrames[0].right.y = 0;
-    m_keyFrames[0].frameDelayStart = 50;
-    m_keyFrames[0].frameDelayStep = 0;
-    m_keyFrames[0].interpolate = true;
+    allPupilsKeyFrame(0, 0, 50, true),
     // Delay and stay at center position for half a second.
-    m_keyFrames[1].left.x = m_keyFrames[1].right.x = 0;
-    m_keyFrames[1].left.y = m_keyFrames[1].right.y = 0;
-    m_keyFrames[1].frameDelayStart = 500;
-    m_keyFrames[1].frameDelayStep = 0;
-    m_keyFrames[1].interpolate = false;
+    allPupilsKeyFrame(0, 0, 500, false),
     // Have each eye look in towards the nose.
-    m_keyFrames[2].left.x = 2;
-    m_keyFrames[2].left.y = 0;
-    m_keyFrames[2].right.x = -2;
-    m_keyFrames[2].right.y = 0;
-    m_keyFrames[2].frameDelayStart = 100;
-    m_keyFrames[2].frameDelayStep = 0;
-    m_keyFrames[2].interpolate = true;
+    pupilsKeyFrame(2, 0, -2, 0, 100, true, EASE_IN_OUT),
     // Delay and stay in crossed state for 2 seconds.
-    m_keyFrames[3].left.x = 2;
-    m_keyFrames[3].left.y = 0;
-    m_keyFrames[3].right.x = -2;
-    m_keyFrames[3].right.y = 0;
-    m_keyFrames[3].frameDelayStart = 2000;
-    m_keyFrames[3].frameDelayStep = 0;
-    m_keyFrames[3].interpolate = false;
+    pupilsKeyFrame(2, 0, -2, 0, 2000, false),
     // Move eyes out to center position again.
-    m_keyFrames[4].left.x = m_keyFrames[4].right.x = 0;
-    m_keyFrames[4].left.y = m_keyFrames[4].right.y = 0;
-    m_keyFrames[4].frameDelayStart = 100;
-    m_keyFrames[4].frameDelayStep = 0;
-    m_keyFrames[4].interpolate = true;
+    allPupilsKeyFrame(0, 0, 100, true, EASE_IN_OUT)
+};
 
-    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames));
+void CrossEyesAnimation::start()
+{
+    PupilAnimation::start(g_crossEyesKeyFrames, ARRAY_SIZE(g_crossEyesKeyFrames));
 }
 
 
 
-void RoundSpinAnimation::start()
+// Each spin of the RoundSpinAnimation steps the pupils clockwise through these positions. The first spin starts
+// slower and the last one ends slower by adding these extra delays to its frames.
+static constexpr PupilPosition g_roundSpinPositions[] =
 {
-    int i = 0;
+    { 2, -1 }, { 1, -2 }, { 0, -2 }, { -1, -2 }, { -2, -1 }, { -2, 0 },
+    { -2, 1 }, { -1, 2 }, { 0, 2 }, { 1, 2 }, { 2, 1 }, { 2, 0 }
+};
+static constexpr uint32_t g_roundSpinFirstDelays[] = { 40, 30, 20, 10, 0, 0, 0, 0, 0, 0, 0, 0 };
+static constexpr uint32_t g_roundSpinLastDelays[] = { 0, 0, 0, 0, 0, 0, 10, 20, 30, 40, 50, 0 };
 
-    // Move eyes to center position first.
-    m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-    m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-    m_keyFrames[i].frameDelayStart = 50;
-    m_keyFrames[i].frameDelayStep = 0;
-    m_keyFrames[i].interpolate = true;
-    i++;
+#define ROUND_SPIN_STEPS        ARRAY_SIZE(g_roundSpinPositions)
+#define ROUND_SPIN_KEY_FRAMES   (2 + ROUND_SPIN_STEPS * ROUND_SPIN_ITERATIONS)
 
-    // Delay and stay at center position for half a second.
-    m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-    m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-    m_keyFrames[i].frameDelayStart = 500;
-    m_keyFrames[i].frameDelayStep = 0;
-    m_keyFrames[i].interpolate = false;
-    i++;
-
-    for (int j = 0 ; j < ROUND_SPIN_ITERATIONS; j++)
-    {
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 2;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = -1;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == 0) ? 40 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 1;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = -2;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == 0) ? 30 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = -2;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == 0) ? 20 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = -1;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = -2;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == 0) ? 10 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = -2;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = -1;
-        m_keyFrames[i].frameDelayStart = 40;
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = -2;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-        m_keyFrames[i].frameDelayStart = 40;
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = -2;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 1;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == ROUND_SPIN_ITERATIONS - 1) ? 10 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = -1;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 2;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == ROUND_SPIN_ITERATIONS - 1) ? 20 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 2;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == ROUND_SPIN_ITERATIONS - 1) ? 30 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 1;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 2;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == ROUND_SPIN_ITERATIONS - 1) ? 40 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 2;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 1;
-        m_keyFrames[i].frameDelayStart = 40 + ((j == ROUND_SPIN_ITERATIONS - 1) ? 50 : 0);
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 2;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-        m_keyFrames[i].frameDelayStart = 40;
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
-    }
-
-    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames));
+// Returns the key frame for one step of the spins.
+static constexpr PupilKeyFrame roundSpinStepKeyFrame(int spin, int step)
+{
+    return allPupilsKeyFrame(g_roundSpinPositions[step].x, g_roundSpinPositions[step].y,
+                             40 + ((spin == 0) ? g_roundSpinFirstDelays[step] : 0) +
+                                  ((spin == ROUND_SPIN_ITERATIONS - 1) ? g_roundSpinLastDelays[step] : 0),
+                             false);
 }
 
+// Returns key frame number frame of the RoundSpinAnimation.
+static constexpr PupilKeyFrame roundSpinKeyFrame(int frame)
+{
+    // Move eyes to center position first and then delay and stay at center position for half a second before spinning.
+    return (frame == 0) ? allPupilsKeyFrame(0, 0, 50, true) :
+           (frame == 1) ? allPupilsKeyFrame(0, 0, 500, false) :
+                          roundSpinStepKeyFrame((frame - 2) / ROUND_SPIN_STEPS, (frame - 2) % ROUND_SPIN_STEPS);
+}
 
+template <int... Frames>
+static constexpr PupilKeyFrameTable<sizeof...(Frames)> roundSpinKeyFrames(IndexList<Frames...>)
+{
+    return PupilKeyFrameTable<sizeof...(Frames)> { { roundSpinKeyFrame(Frames)... } };
+}
 
+static constexpr PupilKeyFrameTable<ROUND_SPIN_KEY_FRAMES> g_roundSpinKeyFrames =
+    roundSpinKeyFrames(MakeIndexList<ROUND_SPIN_KEY_FRAMES>::Type());
 
-void CrazySpinAnimation::start()
+void RoundSpinAnimation::start()
 {
-    int i = 0;
+    PupilAnimation::start(g_roundSpinKeyFrames.frames, ARRAY_SIZE(g_roundSpinKeyFrames.frames));
+}
 
-    // Move eyes to center position first.
-    m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-    m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-    m_keyFrames[i].frameDelayStart = 50;
-    m_keyFrames[i].frameDelayStep = 0;
-    m_keyFrames[i].interpolate = true;
-    i++;
 
-    // Delay and stay at center position for half a second.
-    m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-    m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-    m_keyFrames[i].frameDelayStart = 500;
-    m_keyFrames[i].frameDelayStep = 0;
-    m_keyFrames[i].interpolate = false;
-    i++;
 
-    for (int j = 0 ; j < CRAZY_SPIN_ITERATIONS; j++)
-    {
-        // Scroll the pupil off screen to the left.
-        // Start slow on first iteration and then accelerate to final speed.
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = -5;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-        m_keyFrames[i].frameDelayStart = (j == 0) ? 100 : 50;
-        m_keyFrames[i].frameDelayStep = (j == 0) ? -10 : 0;
-        m_keyFrames[i].interpolate = true;
-        i++;
+#define CRAZY_SPIN_STEPS        3
+#define CRAZY_SPIN_KEY_FRAMES   (2 + CRAZY_SPIN_STEPS * CRAZY_SPIN_ITERATIONS)
 
-        // Jump from left side off of screen to right side off of screen.
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 5;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-        m_keyFrames[i].frameDelayStart = 0;
-        m_keyFrames[i].frameDelayStep = 0;
-        m_keyFrames[i].interpolate = false;
-        i++;
+// Returns the key frame for one step of the spins.
+static constexpr PupilKeyFrame crazySpinStepKeyFrame(int spin, int step)
+{
+    // Scroll the pupil off screen to the left. Start slow on first iteration and then accelerate to final speed.
+    // Then jump from left side off of screen to right side off of screen.
+    // Then scroll the pupil from offscreen right to the center. Decelerate the pupils on the last iteration.
+    return (step == 0) ? allPupilsKeyFrame(-5, 0, (spin == 0) ? 80 : 50, true,
+                                           (spin == 0) ? EASE_IN : EASE_LINEAR) :
+           (step == 1) ? allPupilsKeyFrame(5, 0, 0, false) :
+                         allPupilsKeyFrame(0, 0, (spin == CRAZY_SPIN_ITERATIONS - 1) ? 70 : 50, true,
+                                           (spin == CRAZY_SPIN_ITERATIONS - 1) ? EASE_OUT : EASE_LINEAR);
+}
 
-        // Scroll the pupil from offscreen right to the center.
-        // Decelerate the pupils on the last iteration.
-        m_keyFrames[i].left.x = m_keyFrames[i].right.x = 0;
-        m_keyFrames[i].left.y = m_keyFrames[i].right.y = 0;
-        m_keyFrames[i].frameDelayStart = 50;
-        m_keyFrames[i].frameDelayStep = (j == CRAZY_SPIN_ITERATIONS - 1) ? 10 : 0;
-        m_keyFrames[i].interpolate = true;
-        i++;
-    }
+// Returns key frame number frame of the CrazySpinAnimation.
+static constexpr PupilKeyFrame crazySpinKeyFrame(int frame)
+{
+    // Move eyes to center position first and then delay and stay at center position for half a second before spinning.
+    return (frame == 0) ? allPupilsKeyFrame(0, 0, 50, true) :
+           (frame == 1) ? allPupilsKeyFrame(0, 0, 500, false) :
+                          crazySpinStepKeyFrame((frame - 2) / CRAZY_SPIN_STEPS, (frame - 2) % CRAZY_SPIN_STEPS);
+}
 
-    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames));
+template <int... Frames>
+static constexpr PupilKeyFrameTable<sizeof...(Frames)> crazySpinKeyFrames(IndexList<Frames...>)
+{
+    return PupilKeyFrameTable<sizeof...(Frames)> { { crazySpinKeyFrame(Frames)... } };
 }
 
+static constexpr PupilKeyFrameTable<CRAZY_SPIN_KEY_FRAMES> g_crazySpinKeyFrames =
+    crazySpinKeyFrames(MakeIndexList<CRAZY_SPIN_KEY_FRAMES>::Type());
 
+void CrazySpinAnimation::start()
+{
+    PupilAnimation::start(g_crazySpinKeyFrames.frames, ARRAY_SIZE(g_crazySpinKeyFrames.frames));
+}
 
-void MethEyesAnimation::start()
+
+
+static constexpr PupilKeyFrame g_methEyesKeyFrames[] =
 {
     // Move eyes to center position first.
-    m_keyFrames[0].left.x = m_keyFrames[0].right.x = 0;
-    m_keyFrames[0].left.y = m_keyFrames[0].right.y = 0;
-    m_keyFrames[0].frameDelayStart = 50;
-    m_keyFrames[0].frameDelayStep = 0;
-    m_keyFrames[0].interpolate = true;
+    allPupilsKeyFrame(0, 0, 50, true),
     // Delay and stay at center position for half a second.
-    m_keyFrames[1].left.x = m_keyFrames[1].right.x = 0;
-    m_keyFrames[1].left.y = m_keyFrames[1].right.y = 0;
-    m_keyFrames[1].frameDelayStart = 500;
-    m_keyFrames[1].frameDelayStep = 0;
-    m_keyFrames[1].interpolate = false;
+    allPupilsKeyFrame(0, 0, 500, false),
     // Have each eye look aways from the nose.
-    m_keyFrames[2].left.x = -2;
-    m_keyFrames[2].left.y = 0;
-    m_keyFrames[2].right.x = 2;
-    m_keyFrames[2].right.y = 0;
-    m_keyFrames[2].frameDelayStart = 100;
-    m_keyFrames[2].frameDelayStep = 0;
-    m_keyFrames[2].interpolate = true;
+    pupilsKeyFrame(-2, 0, 2, 0, 100, true, EASE_IN_OUT),
     // Delay and stay in meth state for 2 seconds.
-    m_keyFrames[3].left.x = -2;
-    m_keyFrames[3].left.y = 0;
-    m_keyFrames[3].right.x = 2;
-    m_keyFrames[3].right.y = 0;
-    m_keyFrames[3].frameDelayStart = 2000;
-    m_keyFrames[3].frameDelayStep = 0;
-    m_keyFrames[3].interpolate = false;
+    pupilsKeyFrame(-2, 0, 2, 0, 2000, false),
     // Move eyes out to center position again.
-    m_keyFrames[4].left.x = m_keyFrames[4].right.x = 0;
-    m_keyFrames[4].left.y = m_keyFrames[4].right.y = 0;
-    m_keyFrames[4].frameDelayStart = 100;
-    m_keyFrames[4].frameDelayStep = 0;
-    m_keyFrames[4].interpolate = true;
+    allPupilsKeyFrame(0, 0, 100, true, EASE_IN_OUT)
+};
 
-    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames));
+void MethEyesAnimation::start()
+{
+    PupilAnimation::start(g_methEyesKeyFrames, ARRAY_SIZE(g_methEyesKeyFrames));
 }
 
 
 
-void LazyEyeAnimation::start()
+static constexpr PupilKeyFrame g_lazyEyeKeyFrames[] =
 {
     // Move eyes to look up a bit.
-    m_keyFrames[0].left.x = m_keyFrames[0].right.x = 0;
-    m_keyFrames[0].left.y = m_keyFrames[0].right.y = 1;
-    m_keyFrames[0].frameDelayStart = 50;
-    m_keyFrames[0].frameDelayStep = 0;
-    m_keyFrames[0].interpolate = true;
+    allPupilsKeyFrame(0, 1, 50, true),
     // Delay and stay at center position for half a second.
-    m_keyFrames[1].left.x = m_keyFrames[1].right.x = 0;
-    m_keyFrames[1].left.y = m_keyFrames[1].right.y = 1;
-    m_keyFrames[1].frameDelayStart = 500;
-    m_keyFrames[1].frameDelayStep = 0;
-    m_keyFrames[1].interpolate = false;
+    allPupilsKeyFrame(0, 1, 500, false),
     // Have right eye only look down slowly.
-    m_keyFrames[2].left.x = 0;
-    m_keyFrames[2].left.y = 1;
-    m_keyFrames[2].right.x = 0;
-    m_keyFrames[2].right.y = -2;
-    m_keyFrames[2].frameDelayStart = 150;
-    m_keyFrames[2].frameDelayStep = 0;
-    m_keyFrames[2].interpolate = true;
+    pupilsKeyFrame(0, 1, 0, -2, 150, true),
     // Delay and stay in last state for 1 second2.
-    m_keyFrames[3].left.x = 0;
-    m_keyFrames[3].left.y = 1;
-    m_keyFrames[3].right.x = 0;
-    m_keyFrames[3].right.y = -2;
-    m_keyFrames[3].frameDelayStart = 1000;
-    m_keyFrames[3].frameDelayStep = 0;
-    m_keyFrames[3].interpolate = false;
+    pupilsKeyFrame(0, 1, 0, -2, 1000, false),
     // Move eyes out to center position again at a quick rate.
-    m_keyFrames[4].left.x = m_keyFrames[4].right.x = 0;
-    m_keyFrames[4].left.y = m_keyFrames[4].right.y = 1;
-    m_keyFrames[4].frameDelayStart = 25;
-    m_keyFrames[4].frameDelayStep = 0;
-    m_keyFrames[4].interpolate = true;
+    allPupilsKeyFrame(0, 1, 25, true)
+};
 
-    PupilAnimation::start(m_keyFrames, ARRAY_SIZE(m_keyFrames));
+void LazyEyeAnimation::start()
+{
+    PupilAnimation::start(g_lazyEyeKeyFrames, ARRAY_SIZE(g_lazyEyeKeyFrames));
 }
 
 
 
+// The sequence of brightness commands sent for each iteration of GlowEyesAnimation. The eyes slowly brighten to full
+// brightness and then darken back down twice as fast. The first step of each half repeats the brightness left by the
+// step before it so GlowEyesAnimation skips sending it.
+struct GlowStep
+{
+    uint8_t  brightness;
+    uint16_t delay;
+};
+
+static const GlowStep g_glowSteps[] =
+{
+    {  0,  50 },
+    {  1,  50 },
+    {  2,  50 },
+    {  3,  50 },
+    {  4,  50 },
+    {  5,  50 },
+    {  6,  50 },
+    {  7,  50 },
+    {  8,  50 },
+    {  9,  50 },
+    { 10,  50 },
+    { 11,  50 },
+    { 12,  50 },
+    { 13,  50 },
+    { 14,  50 },
+    { 15, 300 },
+    { 15,  25 },
+    { 14,  25 },
+    { 13,  25 },
+    { 12,  25 },
+    { 11,  25 },
+    { 10,  25 },
+    {  9,  25 },
+    {  8,  25 },
+    {  7,  25 },
+    {  6,  25 },
+    {  5,  25 },
+    {  4,  25 },
+    {  3,  25 },
+    {  2,  25 },
+    {  1,  25 },
+    {  0, 175 }
+};
+
+
 void GlowEyesAnimation::start(int iterations)
 {
     m_iterations = iterations;
 
-    // Start the eye(s) closing on the next call to run().
+    // Start the eyes brightening on the next call to run().
     m_isDone = false;
-    m_state = BRIGHTER;
-    m_brightness = 0;
+    m_step = 0;
     startDelay(0);
 }
 
 void GlowEyesAnimation::run()
+{
+    // Just return if the animation is still waiting for a delay between frames.
+    if (m_isDone || !isDelayDone())
+        return;
+
+    if (m_iterations < 1)
+    {
+        m_isDone = true;
+        return;
+    }
+
+    // Each step is a single brightness command to each display. Steps which repeat the brightness aren't sent again.
+    const GlowStep& step = g_glowSteps[m_step];
+    m_pEyes->setBrightness(step.brightness);
+    scheduleNextDelay(step.delay);
+
+    m_step++;
+    if (m_step >= (int)ARRAY_SIZE(g_glowSteps))
+    {
+        m_step = 0;
+        m_iterations--;
+    }
+}
+
+
+
+void FlashEyesAnimation::start(uint8_t rate, uint32_t duration)
+{
+    assert ( rate != HT16K33_BLINK_OFF && rate <= HT16K33_BLINK_HALFHZ );
+
+    m_rate = rate;
+    m_duration = duration;
+    m_isHardwareBlink = false;
+
+    // Start flashing the eyes on the next call to run().
+    m_isDone = false;
+    m_state = STARTING;
+    startDelay(0);
+}
+
+void FlashEyesAnimation::run()
+{
+    // Just return if the animation is still waiting for a delay between frames.
+    if (!isDelayDone())
+        return;
+
+    switch (m_state)
+    {
+    case STARTING:
+        m_flashStart = m_pEyes->getCurrentTime();
+        m_state = FLASHING;
+        m_isHardwareBlink = m_pEyes->setBlinkRate(m_rate);
+        if (m_isHardwareBlink)
+        {
+            // The controllers take it from here so there is nothing to do until it is time to stop them.
+            scheduleNextDelay(m_duration);
+            break;
+        }
+
+        // Remember where the lids were so that they can be put back after each time the eyes are turned off.
+        for (int i = 0 ; i < EyeMatrices::PUPIL_COUNT ; i++)
+        {
+            EyeMatrices::PupilEnum pupil = (EyeMatrices::PupilEnum)i;
+            m_restLidShape[i] = m_pEyes->getLidShape(pupil);
+            m_restUpperLid[i] = m_pEyes->getUpperLid(pupil);
+            m_restLowerLid[i] = m_pEyes->getLowerLid(pupil);
+        }
+        showEyes(false);
+        scheduleNextDelay(getToggleDelay());
+        break;
+    case FLASHING:
+        if (m_pEyes->getCurrentTime() - m_flashStart >= m_duration)
+        {
+            if (m_isHardwareBlink)
+                m_pEyes->setBlinkRate(HT16K33_BLINK_OFF);
+            else
+                showEyes(true);
+            m_state = DONE;
+            m_isDone = true;
+            break;
+        }
+        showEyes(!m_isOn);
+        scheduleNextDelay(getToggleDelay());
+        break;
+    case DONE:
+        m_isDone = true;
+        break;
+    }
+}
+
+uint32_t FlashEyesAnimation::getToggleDelay()
+{
+    // The HT16K33 blink rates are 2Hz, 1Hz and 0.5Hz with the display on for half of each period.
+    return 250 << (m_rate - HT16K33_BLINK_2HZ);
+}
+
+void FlashEyesAnimation::showEyes(bool isOn)
+{
+    // The eyes are turned off by closing both lids all of the way.
+    for (int i = 0 ; i < EyeMatrices::PUPIL_COUNT ; i++)
+    {
+        EyeMatrices::PupilEnum pupil = (EyeMatrices::PupilEnum)i;
+        if (isOn)
+            m_pEyes->setLids(pupil, m_restLidShape[i], m_restUpperLid[i], m_restLowerLid[i]);
+        else
+            m_pEyes->setLids(pupil, m_restLidShape[i], EyeMatrices::LID_CLOSED, EyeMatrices::LID_CLOSED);
+    }
+    m_pEyes->writeDisplays();
+    m_isOn = isOn;
+}
+
+uint32_t FlashEyesAnimation::getI2CBytesSaved()
+{
+    if (!m_isHardwareBlink)
+        return 0;
+
+    // Flashing in software redraws every display each time the eyes turn on or off where the hardware blink only
+    // needs the two blink rate commands.
+    uint32_t toggles = m_duration / getToggleDelay();
+    uint32_t softwareBytes = toggles * EyeMatrices::DISPLAY_COUNT * FLASH_FRAME_WRITE_BYTES;
+    uint32_t hardwareBytes = 2 * EyeMatrices::DISPLAY_COUNT * HT16K33_COMMAND_WRITE_BYTES;
+    return softwareBytes - hardwareBytes;
+}
+
+
+
+void DilatePupilsAnimation::start(int iterations)
+{
+    m_iterations = iterations;
+
+    // Start the pupils dilating on the next call to run().
+    m_isDone = false;
+    m_state = DILATING;
+    m_size = 0;
+    startDelay(0);
+}
+
+void DilatePupilsAnimation::run()
 {
     // Just return if the animation is still waiting for a delay between frames.
     if (!isDelayDone())
@@ -649,25 +1242,25 @@ void GlowEyesAnimation::run()
     int delay = 0;
     switch (m_state)
     {
-    case BRIGHTER:
-        m_pEyes->setBrightness(m_brightness);
+    case DILATING:
+        m_pEyes->setPupilSize(m_size);
 
-        delay = 50;
-        m_brightness++;
-        if (m_brightness > 15)
+        delay = 80;
+        m_size++;
+        if (m_size >= EyeMatrices::PUPIL_SIZE_COUNT)
         {
-            m_state = DARKER;
-            m_brightness = 15;
-            delay += 250;
+            m_state = CONSTRICTING;
+            m_size = EyeMatrices::PUPIL_SIZE_COUNT - 1;
+            delay += 1000;
         }
-        startDelay(delay);
+        scheduleNextDelay(delay);
         break;
-    case DARKER:
-        m_pEyes->setBrightness(m_brightness);
+    case CONSTRICTING:
+        m_pEyes->setPupilSize(m_size);
 
-        delay = 25;
-        m_brightness--;
-        if (m_brightness < 0)
+        delay = 120;
+        m_size--;
+        if (m_size < 0)
         {
             m_iterations--;
             if (m_iterations < 1)
@@ -676,16 +1269,117 @@ void GlowEyesAnimation::run()
             }
             else
             {
-                m_state = BRIGHTER;
+                m_state = DILATING;
             }
 
-            m_brightness = 0;
-            delay += 150;
+            m_size = 0;
+            delay += 500;
         }
-        startDelay(delay);
+        scheduleNextDelay(delay);
         break;
     case DONE:
         m_isDone = true;
         break;
     }
 }
+
+
+
+// The lid shape and positions used for each of the ExpressionAnimation::Expression values.
+struct ExpressionLids
+{
+    EyeMatrices::LidShape shape;
+    int                   upperLid;
+    int                   lowerLid;
+};
+
+static const ExpressionLids g_expressionLids[ExpressionAnimation::EXPRESSION_COUNT] =
+{
+    // HALF_LIDDED
+    { EyeMatrices::LID_ROUND, EyeMatrices::LID_CLOSED / 2, EyeMatrices::LID_OPEN },
+    // ANGRY
+    { EyeMatrices::LID_ANGRY, EyeMatrices::LID_CLOSED / 4, EyeMatrices::LID_OPEN },
+    // SAD
+    { EyeMatrices::LID_SAD, EyeMatrices::LID_CLOSED / 4, EyeMatrices::LID_OPEN },
+    // SQUINT
+    { EyeMatrices::LID_ROUND, EyeMatrices::LID_CLOSED / 2, EyeMatrices::LID_CLOSED / 4 }
+};
+
+void ExpressionAnimation::start(Expression expression, uint32_t holdTime)
+{
+    assert ( expression >= 0 && expression < EXPRESSION_COUNT );
+    const ExpressionLids* pLids = &g_expressionLids[expression];
+
+    // Every shape of lid looks the same when open so the eyes can switch to the new shape straight away.
+    m_shape = pLids->shape;
+    m_upperTarget = pLids->upperLid;
+    m_lowerTarget = pLids->lowerLid;
+    m_upperLid = EyeMatrices::LID_OPEN;
+    m_lowerLid = EyeMatrices::LID_OPEN;
+    m_holdTime = holdTime;
+
+    // Start the lids moving on the next call to run().
+    m_isDone = false;
+    m_state = LIDS_CLOSING;
+    startDelay(0);
+}
+
+void ExpressionAnimation::run()
+{
+    // Just return if the animation is still waiting for a delay between frames.
+    if (!isDelayDone())
+        return;
+
+    switch (m_state)
+    {
+    case LIDS_CLOSING:
+        // Move each lid a step closer to the expression.
+        if (m_upperLid < m_upperTarget)
+            m_upperLid++;
+        if (m_lowerLid < m_lowerTarget)
+            m_lowerLid++;
+        drawLids();
+
+        if (m_upperLid == m_upperTarget && m_lowerLid == m_lowerTarget)
+        {
+            m_state = HOLDING;
+            scheduleNextDelay(m_holdTime);
+        }
+        else
+        {
+            scheduleNextDelay(MILLISECONDS_FOR_LID_STEP);
+        }
+        break;
+    case HOLDING:
+        m_state = LIDS_OPENING;
+        break;
+    case LIDS_OPENING:
+        if (m_upperLid > EyeMatrices::LID_OPEN)
+            m_upperLid--;
+        if (m_lowerLid > EyeMatrices::LID_OPEN)
+            m_lowerLid--;
+        if (m_upperLid == EyeMatrices::LID_OPEN && m_lowerLid == EyeMatrices::LID_OPEN)
+        {
+            // Leave the eyes with normal lids once they are open again.
+            m_shape = EyeMatrices::LID_ROUND;
+            m_state = DONE;
+        }
+        drawLids();
+
+        scheduleNextDelay(MILLISECONDS_FOR_LID_STEP);
+        break;
+    case DONE:
+        m_isDone = true;
+        break;
+    }
+}
+
+void ExpressionAnimation::drawLids()
+{
+    // Only the lid masks change so each eye is just masked again and flushed once.
+    for (int pupil = 0 ; pupil < EyeMatrices::PUPIL_COUNT ; pupil++)
+    {
+        m_pEyes->setLids((EyeMatrices::PupilEnum)pupil, m_shape, m_upperLid, m_lowerLid);
+    }
+    m_pEyes->writeDisplays();
+}
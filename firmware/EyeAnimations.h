@@ -12,114 +12,334 @@
    See the License for the specific language governing permissions and
    limitations under the License.
 */
-/* Eye animations using Adafruit's 8x8 LED Matrix.
+/* Eye animations using Adafruit's 8x8 LED Matrix (or any other IEyeDisplay backend).
    Ported from Michal T Janyst's Led Eyes project (https://github.com/michaltj/LedEyes)
 */
 #include <assert.h>
+#include <new>
 #include <mbed.h>
-#include "Adafruit_LEDBackpack.h"
-
-
+#include "Easing.h"
+#include "EyeDisplay.h"
+
+
+
+// The number of eyes (8x8 displays) driven by EyeMatrices. Props with more than 2 eyes can override this from the
+// makefile. The eyes alternate between being treated as left (even indices) and right (odd indices) eyes by the
+// animations so that each pair acts like the original 2 eyes. The HT16K33 only supports I2C addresses 0x70 - 0x77 so
+// more than 8 eyes requires using more than one I2C bus.
+#ifndef EYE_COUNT
+#define EYE_COUNT               2
+#endif
+
+// The width and height of each eye in pixels. Must be 8 or 16. Eyes larger than 8x8 are built from multiple 8x8
+// tiles, each of which is drawn through its own IEyeDisplay. For example, a 16x16 eye can be built from a pair of
+// HT16K33 16x8 backpacks. The makefile can override this and the rest of the eye geometry below.
+#ifndef EYE_SIZE
+#define EYE_SIZE                8
+#endif
+
+// The diameter in pixels of the round eye ball drawn in the center of each eye.
+#ifndef EYE_BALL_DIAMETER
+#define EYE_BALL_DIAMETER       EYE_SIZE
+#endif
+
+// The size in pixels of the normal pupil and how many sizes it can be dilated through, each one 2 pixels larger than
+// the one before it. Sizes should be even so that the pupil can be centered on an eye with an even size.
+#ifndef EYE_PUPIL_MIN_SIZE
+#define EYE_PUPIL_MIN_SIZE      (EYE_SIZE / 4)
+#endif
+#ifndef EYE_PUPIL_SIZE_COUNT
+#define EYE_PUPIL_SIZE_COUNT    3
+#endif
+#define EYE_PUPIL_MAX_SIZE      (EYE_PUPIL_MIN_SIZE + 2 * (EYE_PUPIL_SIZE_COUNT - 1))
+
+// Set to 1 for round pupils or 0 for square ones. The two are the same for the 2x2 pupil of the original 8x8 eyes.
+#ifndef EYE_PUPIL_ROUND
+#define EYE_PUPIL_ROUND         1
+#endif
+
+// How many times larger the eyes are than the original 8x8 eyes. The canned animations scale their pupil offsets by
+// this so that they cover the same part of the eye.
+#define EYE_SCALE               (EYE_SIZE / 8)
+// The number of 8x8 tiles across each eye and in total.
+#define EYE_TILES_ACROSS        (EYE_SIZE / 8)
+#define EYE_TILE_COUNT          (EYE_TILES_ACROSS * EYE_TILES_ACROSS)
 
 // Number of times the RoundSpinAnimation should spin the pupils.
+#ifndef ROUND_SPIN_ITERATIONS
 #define ROUND_SPIN_ITERATIONS   2
+#endif
 // Number of times the CrazySpinAnimation should spin the pupils.
+#ifndef CRAZY_SPIN_ITERATIONS
 #define CRAZY_SPIN_ITERATIONS   2
+#endif
+// The default number of milliseconds between BlinkAnimation frames. Larger eyes have more lid positions so they draw
+// them faster in order to still show every position.
+#define BLINK_FRAME_DELAY_DEFAULT   (40 / EYE_SCALE)
+// The number of milliseconds it takes the lids to close during a blink. They take the same amount of time to open
+// again.
+#define MILLISECONDS_FOR_BLINK_CLOSE        160
+// The most animations which can be played at the same time by an EyeAnimationTracks object.
+#define EYE_ANIMATION_TRACK_COUNT   4
+// The most milliseconds that an animation step can be behind schedule before EyeAnimationBase::scheduleNextDelay()
+// gives up on catching up and just schedules the next step from the current time.
+#define EYE_ANIMATION_MAX_LATENESS  100
+// Value returned from EyeMatrices::getBrightness() before the brightness has ever been set.
+#define EYE_BRIGHTNESS_UNKNOWN      0xFF
 
 
 // Used to indicate the position of the pupil in each eye. 0,0 places the pupil in the center of the eye. The limits
-// of the offsets are -5 and 5 (EyeMatrices::PupilLimits). The x values increase as you progress to the right and the
-// y values increase as you progress up. It should be noted that placing pupils at the limits (-5 & 5) will cause them
-// to be rendered outside the matrix and therefore the pupil will disappear.
+// of the offsets are EyeMatrices::MIN and EyeMatrices::MAX (-7 and 7 for the default 8x8 eyes). The x values increase
+// as you progress to the right and the y values increase as you progress up. It should be noted that placing pupils at
+// the limits will cause them to be rendered outside the matrix and therefore the pupil will disappear.
 struct PupilPosition
 {
     int x;
     int y;
 };
 
+// Eased pupil motions are split into this many steps for each pixel of distance, with the frameDelayStart of each
+// pixel shared between them, so that the fast parts of a curve don't make the pupil jump across several pixels at once.
+#define PUPIL_EASING_STEP_SHIFT         2
+#define PUPIL_EASING_STEPS_PER_PIXEL    (1 << PUPIL_EASING_STEP_SHIFT)
+
 // An array of PupilKeyFrame structures are passed into the PupilAnimation::start() method. They indicate how the
 // pupil should be animated around within the eye.
 struct PupilKeyFrame
 {
-    // Location of the left pupil (-5 to 5).
-    PupilPosition left;
-    // Location of the right pupil (-5 to 5).
-    PupilPosition right;
-    // The number of milliseconds to delay between steps (sub-frames) of the interpolation.
+    // Location of each pupil (MIN to MAX). Even indices are left eyes and odd indices are right eyes.
+    PupilPosition pupils[EYE_COUNT];
+    // The number of milliseconds to delay between steps (sub-frames) of the interpolation. Each step moves the pupil
+    // by a pixel so the motion takes frameDelayStart times the distance moved, no matter which easing curve is used.
     uint32_t      frameDelayStart;
     // After each step in the animation, the frame delay will be increased by this amount (or decreased if negative).
-    // This allows for acceleration to take place during the interpolated animation.
+    // This allows for acceleration to take place during a linear interpolated animation. It is ignored when easing is
+    // used instead.
     int32_t       frameDelayStep;
     // Should the location of the pupil be interpolated and rendered as it moves from the previous location to the new
     // location or should it just jump to the new location.
     bool          interpolate;
+    // The curve the interpolated motion follows. Anything other than EASE_LINEAR splits each pixel of the motion into
+    // PUPIL_EASING_STEPS_PER_PIXEL steps so that the pupil speeds up and slows down smoothly.
+    EasingCurve   easing;
 };
 
 
-// This class contains two instantiations of the Adafruit 8x8 matrices, one for each eye.
+// The image of a whole eye, stored as EYE_TILE_COUNT 8x8 bitboards (see Bitboard.h). The tiles are stored in row order
+// so tiles[0] is the top left corner of the eye and tiles[EYE_TILES_ACROSS] is just below it.
+struct EyeImage
+{
+    uint64_t tiles[EYE_TILE_COUNT];
+};
+
+
+// This class animates EYE_COUNT eyes, rendering each 8x8 tile of them through its own IEyeDisplay backend.
 class EyeMatrices
 {
 public:
-    // The limits of the offsets that can be used for the location of pupils. It should be noted that when placed at the
-    // far limits, the pupils will disappear.
+    // The limits of the offsets that can be used for the location of pupils. They are just far enough for the largest
+    // pupil to be moved completely off of the eye so it should be noted that when placed at the far limits, the pupils
+    // will disappear.
     enum PupilLimits
     {
-        MIN = -5,
-        MAX = 5
+        MIN = -(EYE_SIZE / 2 + EYE_PUPIL_MAX_SIZE / 2),
+        MAX = EYE_SIZE / 2 + EYE_PUPIL_MAX_SIZE / 2
     };
 
-    // There are two pupils: left and right.
+    // The number of valid pupil positions along each axis.
+    enum
+    {
+        POSITION_COUNT = MAX - MIN + 1
+    };
+
+    // There are EYE_COUNT pupils. The first two are the original left and right eyes and any others are numbered
+    // from there.
     enum PupilEnum
     {
         LEFT = 0,
         RIGHT = 1,
-        PUPIL_COUNT = 2
+        PUPIL_COUNT = EYE_COUNT
+    };
+
+    // The number of IEyeDisplay backends used for all of the eyes and the number of pupil sizes.
+    enum
+    {
+        DISPLAY_COUNT = EYE_COUNT * EYE_TILE_COUNT,
+        PUPIL_SIZE_COUNT = EYE_PUPIL_SIZE_COUNT
     };
 
-    // Constructor - Initializes the 8x8 matrices on the I2C bus and sets the brightness to its lowest setting for both.
-    //  pI2C is a pointer to the mbed I2C bus object to which both of the matrices have been attached.
-    //  leftEyeAddress is the 7-bit I2C address of the 8x8 matrix to be used for the left eye.
-    //  rightEyeAddress is the 7-bit I2C address of the 8x8 matrix to be used for the right eye.
-    EyeMatrices(I2C* pI2C, uint8_t leftEyeAddress = 0x70, uint8_t rightEyeAddress = 0x71);
+    // The shapes of the upper eye lids. The slanted shapes are mirrored on the right (odd) eyes so that the angry lids
+    // always slope down towards the nose and the sad lids slope down away from it. The lower lids are always round.
+    enum LidShape
+    {
+        LID_ROUND,
+        LID_ANGRY,
+        LID_SAD,
+        LID_SHAPE_COUNT
+    };
 
-    // Initializes the eye matrices to draw the eyes with both pupils centered.
+    // The positions of the lids. Each position lowers the upper lid (or raises the lower lid) by another row at the
+    // center of the eye. The upper and lower lids meet in the middle when both are LID_CLOSED.
+    enum LidLimits
+    {
+        LID_OPEN = 0,
+        LID_CLOSED = EYE_SIZE / 2,
+        LID_POSITION_COUNT = LID_CLOSED + 1
+    };
+
+    // Bit masks of the even (left) and odd (right) eyes, as used by BlinkAnimation::startEyes().
+    enum
+    {
+        ALL_EYES_MASK = (int)((1ULL << EYE_COUNT) - 1),
+        LEFT_EYES_MASK = (int)(0x55555555 & ALL_EYES_MASK),
+        RIGHT_EYES_MASK = (int)(0xAAAAAAAA & ALL_EYES_MASK)
+    };
+    static_assert(EYE_COUNT >= 2 && EYE_COUNT <= 31, "EYE_COUNT must be between 2 and 31.");
+    // The precomputed frames for every pupil size and position take 60k of FLASH for 16x16 eyes and would take several
+    // hundred k for anything larger.
+    static_assert(EYE_SIZE == 8 || EYE_SIZE == 16, "EYE_SIZE must be 8 or 16.");
+
+    // Constructor
+    //  ppDisplays points to an array of DISPLAY_COUNT pointers to the already initialized display backend for each
+    //             tile of each eye. The EYE_TILE_COUNT tiles of eye 0 come first, in EyeImage order, followed by the
+    //             tiles of eye 1, etc. HT16K33EyeDisplay objects on different I2C controllers will have their writes
+    //             for a frame sent at the same time so that those eyes update in lock-step.
+    EyeMatrices(IEyeDisplay* const* ppDisplays);
+
+    // Initializes the eye matrices to draw the eyes with all pupils centered.
     void init()
     {
-        PupilPosition pos = {0, 0};
-        displayEyes(&pos, &pos);
+        PupilPosition pos[PUPIL_COUNT];
+        for (int pupil = 0 ; pupil < PUPIL_COUNT ; pupil++)
+        {
+            pos[pupil].x = 0;
+            pos[pupil].y = 0;
+        }
+        displayEyes(pos);
+    }
+
+    // Display the eyes with each pupil located at the designated position. Only the eyes whose image actually changes
+    // are sent out to their matrices.
+    //  pPositions points to an array of PUPIL_COUNT structs representing the x,y coordinates of each pupil. (0,0) is
+    //             centered, (-2,-2) is the lower left corner, and (2, 2) is the upper right corner of an 8x8 eye.
+    void displayEyes(const PupilPosition* pPositions);
+
+    // Switches all of the pupils to one of the precomputed pupil sizes and redraws the eyes with it right away. The
+    // frames for every size are generated at compile time so this costs no more than moving the pupils.
+    //  sizeIndex is the size to switch to. 0 is the normal EYE_PUPIL_MIN_SIZE pupil and each index after that is 2
+    //            pixels larger, up to PUPIL_SIZE_COUNT - 1. Values outside of that range are capped.
+    void setPupilSize(int sizeIndex);
+
+    // Returns the index of the pupil size currently being displayed.
+    int getPupilSize()
+    {
+        return m_pupilSize;
     }
 
-    // Display the eyes with each pupil located at the designated position.
-    //  pLeftPos is a pointer to the struct representing the x,y coordinates of the left eye. (0,0) is centered,
-    //           (-2,-2) is the lower left corner, and (2, 2) is the upper right corner.
-    //  pRightPos is a pointer to the struct representing the x,y coordinates of the right eye. (0,0) is centered,
-    //           (-2,-2) is the lower left corner, and (2, 2) is the upper right corner.
-    void displayEyes(const PupilPosition* pLeftPos, const PupilPosition* pRightPos);
+    // Has displayEyes() soften the edges of the pupils by drawing the pixels of the eye ball which border them at about
+    // half brightness. The eyes are then drawn with drawEyeGrayscale() so only HT16K33GrayscaleEyeDisplay shows the
+    // dimmer rim. The other backends show it at full brightness, the same as a hard edged pupil. Takes effect the next
+    // time that the pupils are drawn.
+    //  isSoft is true to draw soft edged pupils and false to just draw the precomputed pupil frames.
+    void setSoftPupils(bool isSoft)
+    {
+        m_isSoftPupils = isSoft;
+    }
+
+    // Sets the shape and position of the lids over one eye. The lids are masks which are precomputed at compile time
+    // and laid over the image of the eye so they can be moved independently of the pupil. Should call writeDisplays()
+    // later to have the change sent to the matrices to be rendered.
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  shape is the shape of the upper lid.
+    //  upperLid is how far the upper lid is lowered. Values outside of LID_OPEN to LID_CLOSED are capped.
+    //  lowerLid is how far the lower lid is raised. Values outside of LID_OPEN to LID_CLOSED are capped.
+    void setLids(PupilEnum pupil, LidShape shape, int upperLid, int lowerLid);
+
+    // Returns the current shape of the upper lid over the specified eye.
+    LidShape getLidShape(PupilEnum pupil)
+    {
+        return m_lidShape[pupil];
+    }
+
+    // Returns the current position of the upper lid over the specified eye.
+    int getUpperLid(PupilEnum pupil)
+    {
+        return m_upperLid[pupil];
+    }
+
+    // Returns the current position of the lower lid over the specified eye.
+    int getLowerLid(PupilEnum pupil)
+    {
+        return m_lowerLid[pupil];
+    }
 
     // Temporarily turns off all pixels in a single row of the specified eye matrix.
     // This is useful for eye wink animations. The previous state of the row is still remembered and can be restored via
     // a call to the restoreRow() method.
-    //  pupil specifies the eye to be updated. Allowed values are EyeMatrices::LEFT or EyeMatrices::RIGHT.
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
     //  row specifies the row for which all pixels should be temporarily turned off. Allowed values are between
-    //      0 and 7.
+    //      0 and EYE_SIZE - 1.
     void turnRowOffTemporarily(PupilEnum pupil, int row);
 
     // Restores a row of pixels that have previously been turned off via a call to the turnRowOffTemporarily() method.
-    //  pupil specifies the eye to be updated. Allowed values are EyeMatrices::LEFT or EyeMatrices::RIGHT.
-    //  row specifies the row for which all pixels should be restored. Allowed values are between 0 and 7.
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  row specifies the row for which all pixels should be restored. Allowed values are between 0 and EYE_SIZE - 1.
     void restoreRow(PupilEnum pupil, int row);
 
-    // Sets the brightness of both eye matrices to the same value.
+    // Sets the brightness of all eye displays to the same value and sends it to them right away. The HT16K33 backends
+    // don't send a brightness which the display already has.
     //  brightness is the desired brightness. Allowed values are between 0 (BRIGHTNESS_MIN) and 15 (BRIGHTNESS_MAX).
-    void setBrightness(uint8_t brightness)
+    void setBrightness(uint8_t brightness);
+
+    // Returns the brightness most recently set with setBrightness() or EYE_BRIGHTNESS_UNKNOWN if it hasn't been called
+    // yet.
+    uint8_t getBrightness()
+    {
+        return m_brightness;
+    }
+
+    // Has the display controllers blink all of the eyes on their own so that nothing needs to be sent to them while
+    // they blink. Returns false if any of the displays can't blink on their own, in which case none of them are left
+    // blinking and the caller needs to blink the eyes in software instead.
+    //  rate is one of HT16K33_BLINK_OFF, HT16K33_BLINK_2HZ, HT16K33_BLINK_1HZ, or HT16K33_BLINK_HALFHZ.
+    bool setBlinkRate(uint8_t rate);
+
+    // Draws an arbitrary image into the specified eye matrix. Should call writeDisplays() later to have the image sent
+    // to the matrices to be rendered.
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  image is the image to be drawn. Its tiles are 8x8 bitboards so see Bitboard.h for their format and functions
+    //        which can be used to shift, scroll, mirror, rotate and mask them.
+    void drawEye(PupilEnum pupil, const EyeImage& image);
+
+    // Draws a grayscale image into the specified eye matrix. Backends which can't show grayscale (anything but
+    // HT16K33GrayscaleEyeDisplay) just show the pixels which are at least half brightness. Should call writeDisplays()
+    // later to have the image sent to the matrices to be rendered.
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  pPlanes points to an array of planeCount images, one for each bit of the pixel levels. pPlanes[0] holds the
+    //          least significant bit of each pixel's level.
+    //  planeCount is the number of bit planes in pPlanes (1 - EYE_DISPLAY_MAX_PLANES).
+    void drawEyeGrayscale(PupilEnum pupil, const EyeImage* pPlanes, int planeCount);
+
+    // Returns the image currently drawn in the specified eye, without any temporarily turned off rows.
+    //  pupil specifies the eye. Allowed values are 0 to PUPIL_COUNT - 1.
+    EyeImage getEye(PupilEnum pupil)
     {
-        left()->setBrightness(brightness);
-        right()->setBrightness(brightness);
+        return m_eyeCurrent[pupil];
     }
 
-    // Validates the x, y coordinates and caps them at the allowed [-5, 5] limits.
+    // Returns the precomputed image of the eye with the pupil at the specified location. The images are generated at
+    // compile time and stored in FLASH.
+    //  pPos points to the x,y coordinates of the pupil. They are capped at the allowed [MIN, MAX] limits.
+    //  sizeIndex is the size of the pupil (0 - PUPIL_SIZE_COUNT - 1).
+    static const EyeImage& getPupilFrame(const PupilPosition* pPos, int sizeIndex = 0);
+
+    // Returns the image of the whole eye ball without a pupil. Display backends which colour in the eye (like
+    // NeoPixelEyeDisplay) use it to tell the pupil and lids apart from the background.
+    static EyeImage getEyeBallFrame();
+
+    // Validates the x, y coordinates and caps them at the allowed [MIN, MAX] limits.
     //  pPos points to the x,y coordinates to be validated.
-    //  Returns the x,y coordinates after they have both been limited to fall between -5 and 5 (inclusively).
+    //  Returns the x,y coordinates after they have both been limited to fall between MIN and MAX (inclusively).
     static PupilPosition getValidPupilPosition(const PupilPosition* pPos)
     {
         int x = pPos->x;
@@ -138,13 +358,28 @@ public:
         return validPos;
     }
 
-    // Writes the display buffer out to the 8x8 matrices to be rendered.
+    // Flushes the rendered images out to the eye displays. Returns immediately and the writes complete in the
+    // background. Only the eyes which have been drawn into since the last call are flushed and they are flushed back
+    // to back so that they go out at the same time when the eyes are attached to different buses.
     // Should be called after drawRow() has been used to manually update rows on the matrix displays. The displayEyes()
-    // method calls this method internally so it doesn't need to be called again.
-    void writeDisplays()
+    // method calls this method internally so it doesn't need to be called again. Nothing is flushed between
+    // beginUpdate() and endUpdate().
+    void writeDisplays();
+
+    // Holds off the flushes from writeDisplays() until the matching endUpdate(). This lets several animations draw
+    // into the eyes during a tick while each eye is still only flushed once, with the changes from all of them.
+    // Calls can be nested.
+    void beginUpdate()
+    {
+        m_updateDepth++;
+    }
+
+    // Ends an update started with beginUpdate() and flushes every eye which was drawn into during it.
+    void endUpdate()
     {
-        m_leftEye.writeDisplay();
-        m_rightEye.writeDisplay();
+        assert ( m_updateDepth > 0 );
+        m_updateDepth--;
+        writeDisplays();
     }
 
     // Returns the current value of the 32-bit millisecond counter.
@@ -154,7 +389,7 @@ public:
     }
 
     // Returns the current pupil position for the specified eye.
-    //  pupil specifies which eye location is desired. Allowed values are EyeMatrices::LEFT or EyeMatrices::RIGHT.
+    //  pupil specifies which eye location is desired. Allowed values are 0 to PUPIL_COUNT - 1.
     PupilPosition getPupilPos(PupilEnum pupil)
     {
         return m_currentPos[pupil];
@@ -162,64 +397,53 @@ public:
 
 
 protected:
-    // Returns a pointer to the driver object for the left 8x8 eye matrix.
-    Adafruit_8x8matrix* left()
-    {
-        return &m_leftEye;
-    }
-
-    // Returns a pointer to the driver object for the right 8x8 eye matrix.
-    Adafruit_8x8matrix* right()
+    // Returns a pointer to the display backend for one tile of the requested eye.
+    //  pupil specifies which eye's display should be returned. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  tile specifies which tile of the eye. Allowed values are 0 to EYE_TILE_COUNT - 1.
+    IEyeDisplay* eye(PupilEnum pupil, int tile = 0)
     {
-        return &m_rightEye;
-    }
-
-    // Returns a pointer to the driver object for the requested eye matrix.
-    //  pupil specifies which matrix should be returned. Allowed values are LEFT or RIGHT.
-    Adafruit_8x8matrix* eye(PupilEnum pupil)
-    {
-        switch (pupil)
-        {
-        case LEFT:
-            return left();
-            break;
-        case RIGHT:
-            return right();
-            break;
-        default:
-            assert ( pupil == LEFT || pupil == RIGHT );
-            return NULL;
-        }
+        assert ( pupil >= 0 && pupil < PUPIL_COUNT );
+        assert ( tile >= 0 && tile < EYE_TILE_COUNT );
+        return m_pDisplays[pupil * EYE_TILE_COUNT + tile];
     }
 
     // Low level function for setting individual pixels on the specified row of a particular eye matrix.
     // Should call writeDisplays() later to have the row updates sent to the matrices to be rendered.
-    //  pupil is either EyeMatrices::LEFT or EyeMatrices::RIGHT.
-    //  row is the row of the 8x8 matrix to be updated. Allowed values are 0 to 7.
-    //  rowData is an 8-bit value representing the state for each of the 8 pixels in the specified row. The least
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  row is the row of the eye to be updated. Allowed values are 0 to EYE_SIZE - 1.
+    //  rowData is an EYE_SIZE-bit value representing the state for each of the pixels in the specified row. The least
     //          significant bit represents the leftmost pixel and the most significant bit represents the rightmost
     //          pixel. A bit value of 1 turns the pixel on and a value of 0 turns it off.
-    void drawRow(PupilEnum pupil, int row, uint8_t rowData)
-    {
-        switch (pupil)
-        {
-        case LEFT:
-            m_leftEye.drawRow(row, rowData);
-            break;
-        case RIGHT:
-            m_rightEye.drawRow(row, rowData);
-            break;
-        default:
-            assert ( pupil == LEFT || pupil == RIGHT );
-            break;
-        }
-    }
-
-    uint8_t            m_eyeCurrent[PUPIL_COUNT][8];
+    void drawRow(PupilEnum pupil, int row, uint32_t rowData);
+
+    // Draws the eye with a soft edged pupil, as described in setSoftPupils().
+    //  pupil specifies the eye to be updated. Allowed values are 0 to PUPIL_COUNT - 1.
+    //  frame is the precomputed image of the eye with its pupil in place.
+    void drawSoftPupil(PupilEnum pupil, const EyeImage& frame);
+
+    // Submits the visible parts of the eye's current image to its display backends.
+    void renderEye(PupilEnum pupil);
+
+    // The current image of each eye and the mask of rows (bit 0 is the top row) which haven't been temporarily turned
+    // off. Eyes drawn with drawEyeGrayscale() also have their bit planes in m_eyePlanes, with m_eyeCurrent holding
+    // every lit pixel. m_lidMask holds the pixels of each eye which aren't covered by its lids.
+    EyeImage           m_eyeCurrent[PUPIL_COUNT];
+    uint32_t           m_visibleRows[PUPIL_COUNT];
+    EyeImage           m_lidMask[PUPIL_COUNT];
+    LidShape           m_lidShape[PUPIL_COUNT];
+    uint8_t            m_upperLid[PUPIL_COUNT];
+    uint8_t            m_lowerLid[PUPIL_COUNT];
+    EyeImage           m_eyePlanes[PUPIL_COUNT][EYE_DISPLAY_MAX_PLANES];
+    int                m_eyePlaneCount[PUPIL_COUNT];
     PupilPosition      m_currentPos[PUPIL_COUNT];
-    Adafruit_8x8matrix m_leftEye;
-    Adafruit_8x8matrix m_rightEye;
+    IEyeDisplay*       m_pDisplays[DISPLAY_COUNT];
+    int                m_pupilSize;
+    bool               m_isSoftPupils;
+    uint8_t            m_brightness;
     Timer              m_timer;
+    // Each bit represents one eye which has been rendered since the last writeDisplays().
+    uint32_t           m_dirtyEyes;
+    int                m_updateDepth;
 };
 
 
@@ -236,6 +460,8 @@ public:
         m_pEyes = pEyes;
         m_startTime = 0;
         m_desiredDelay = 0;
+        m_lateness = 0;
+        m_maxLateness = 0;
     }
 
     // Virtual destructor.
@@ -243,12 +469,48 @@ public:
     {
     }
 
-    // Starts a delay timer. isDelayDone() will return true once the timer has expired.
+    // Starts a delay timer from the current time. isDelayDone() will return true once the timer has expired. Used
+    // when starting an animation. The following steps of the animation should use scheduleNextDelay() instead.
     //  desiredDelay specifies the delay time in milliseconds.
     void startDelay(uint32_t desiredDelay)
     {
         m_startTime = m_pEyes->getCurrentTime();
         m_desiredDelay = desiredDelay;
+        m_lateness = 0;
+        m_maxLateness = 0;
+    }
+
+    // Starts a delay timer which expires desiredDelay milliseconds after the previous one was due to expire, rather
+    // than after the current time. The time it took to notice the last delay expiring and to render and send the
+    // frame since then is taken out of this delay so that an animation runs at exactly the pace set by its delays. If
+    // the animation has fallen more than EYE_ANIMATION_MAX_LATENESS behind though, it is restarted from the current
+    // time rather than rushing through the frames it missed.
+    //  desiredDelay specifies the delay time in milliseconds.
+    void scheduleNextDelay(uint32_t desiredDelay)
+    {
+        uint32_t currentTime = m_pEyes->getCurrentTime();
+        uint32_t deadline = m_startTime + m_desiredDelay;
+
+        m_lateness = (int32_t)(currentTime - deadline) > 0 ? currentTime - deadline : 0;
+        if (m_lateness > m_maxLateness)
+            m_maxLateness = m_lateness;
+
+        m_startTime = m_lateness > EYE_ANIMATION_MAX_LATENESS ? currentTime : deadline;
+        m_desiredDelay = desiredDelay;
+    }
+
+    // Returns how many milliseconds after its deadline the most recent step of the animation was scheduled from
+    // scheduleNextDelay(). This is how long it took to get around to running the animation once its delay expired
+    // plus the time it took to render and send its frame.
+    uint32_t getLateness()
+    {
+        return m_lateness;
+    }
+
+    // Returns the largest getLateness() since the animation was started.
+    uint32_t getMaxLateness()
+    {
+        return m_maxLateness;
     }
 
     // Queries whether a delay timer set by startDelay() has expired yet or not.
@@ -271,10 +533,20 @@ public:
     // Should return false while the animation is still in progress and then return true once it has completed.
     virtual bool isDone() = 0;
 
+    // Returns an estimate of how many bytes of I2C traffic the most recent run of this animation avoided by having
+    // the display controllers do the work themselves instead of having it sent to them. Animations which don't
+    // offload anything just use this default of 0.
+    virtual uint32_t getI2CBytesSaved()
+    {
+        return 0;
+    }
+
 protected:
     EyeMatrices* m_pEyes;
     uint32_t     m_startTime;
     uint32_t     m_desiredDelay;
+    uint32_t     m_lateness;
+    uint32_t     m_maxLateness;
 };
 
 
@@ -316,6 +588,170 @@ protected:
 };
 
 
+// Plays several eye animations at the same time, each on its own track. For example one track can move the pupils
+// while another blinks the lids and a third pulses the brightness, or each track can animate a different eye. Every
+// call to run() gives each track a turn between EyeMatrices::beginUpdate() and endUpdate() so that all of their
+// changes for that tick are merged and each eye is flushed to its display once, no matter how many tracks changed it.
+// Tracks which animate the same thing on the same eye just overwrite each other.
+class EyeAnimationTracks
+{
+public:
+    // Constructor
+    //  pEyes is a pointer to the EyeMatrices object which the animations on the tracks render into.
+    EyeAnimationTracks(EyeMatrices* pEyes)
+    {
+        m_pEyes = pEyes;
+        for (int track = 0 ; track < EYE_ANIMATION_TRACK_COUNT ; track++)
+        {
+            m_pAnimations[track] = NULL;
+        }
+    }
+
+    // Plays an animation on a track, replacing whatever animation it was playing before.
+    //  track is the track to be used (0 - EYE_ANIMATION_TRACK_COUNT - 1).
+    //  pAnimation is the animation to be played. Its start() method should have already been called. An animation
+    //             shouldn't be played on more than one track at a time.
+    void play(int track, EyeAnimationBase* pAnimation)
+    {
+        assert ( track >= 0 && track < EYE_ANIMATION_TRACK_COUNT );
+        m_pAnimations[track] = pAnimation;
+    }
+
+    // Stops playing the animation on a track.
+    //  track is the track to be stopped (0 - EYE_ANIMATION_TRACK_COUNT - 1).
+    void stop(int track)
+    {
+        play(track, NULL);
+    }
+
+    // Returns the animation being played on a track or NULL if the track is empty.
+    //  track is the track to be queried (0 - EYE_ANIMATION_TRACK_COUNT - 1).
+    EyeAnimationBase* getAnimation(int track)
+    {
+        assert ( track >= 0 && track < EYE_ANIMATION_TRACK_COUNT );
+        return m_pAnimations[track];
+    }
+
+    // Returns true if the track is empty or its animation has completed.
+    //  track is the track to be queried (0 - EYE_ANIMATION_TRACK_COUNT - 1).
+    bool isDone(int track)
+    {
+        EyeAnimationBase* pAnimation = getAnimation(track);
+        return pAnimation == NULL || pAnimation->isDone();
+    }
+
+    // Returns true once the animations on all of the tracks have completed.
+    bool isDone();
+
+    // Gives each track which is still playing a chance to run its animation and then flushes the eyes they changed.
+    void run();
+
+protected:
+    EyeMatrices*      m_pEyes;
+    EyeAnimationBase* m_pAnimations[EYE_ANIMATION_TRACK_COUNT];
+};
+
+
+// Templates used by EyeAnimationSlot to find the position of a type in its list of animation types and the storage
+// needed for the largest of them. Looking up a type which isn't in the list fails to compile.
+template <typename T, typename... Types>
+struct EyeAnimationTypeIndex;
+template <typename T, typename... Rest>
+struct EyeAnimationTypeIndex<T, T, Rest...>
+{
+    enum { value = 0 };
+};
+template <typename T, typename First, typename... Rest>
+struct EyeAnimationTypeIndex<T, First, Rest...>
+{
+    enum { value = 1 + EyeAnimationTypeIndex<T, Rest...>::value };
+};
+
+template <typename... Types>
+struct EyeAnimationStorage
+{
+    enum { size = 1, alignment = 1 };
+};
+template <typename First, typename... Rest>
+struct EyeAnimationStorage<First, Rest...>
+{
+    enum
+    {
+        size = (sizeof(First) > (size_t)EyeAnimationStorage<Rest...>::size) ?
+               sizeof(First) : (size_t)EyeAnimationStorage<Rest...>::size,
+        alignment = (alignof(First) > (size_t)EyeAnimationStorage<Rest...>::alignment) ?
+                    alignof(First) : (size_t)EyeAnimationStorage<Rest...>::alignment
+    };
+};
+
+// Holds one animation at a time out of a fixed list of animation types. Animations which are never played at the same
+// time, such as the ones which take turns on a single EyeAnimationTracks track, can share a slot so that together they
+// only take up the RAM of the largest of them. An animation is constructed in the slot when it is needed and destroyed
+// when the next one replaces it so it has to be started again each time it is created.
+template <typename... Animations>
+class EyeAnimationSlot
+{
+public:
+    // Constructor
+    //  pEyes is a pointer to the EyeMatrices object passed to the constructor of each animation created in the slot.
+    EyeAnimationSlot(EyeMatrices* pEyes)
+    {
+        m_pEyes = pEyes;
+        m_pAnimation = NULL;
+        m_type = 0;
+    }
+
+    // Destructor.
+    ~EyeAnimationSlot()
+    {
+        destroy();
+    }
+
+    // Replaces the animation in the slot with a newly constructed animation of type T, which must be one of the slot's
+    // Animations. The previous animation is destroyed so a track which was playing it must be given the new one, or
+    // stopped, before the tracks are run again.
+    //  Returns a pointer to the new animation so that it can be started.
+    template <typename T>
+    T* create()
+    {
+        destroy();
+        T* pAnimation = new (m_storage) T(m_pEyes);
+        m_pAnimation = pAnimation;
+        m_type = EyeAnimationTypeIndex<T, Animations...>::value;
+        return pAnimation;
+    }
+
+    // Returns the animation in the slot if it is of type T and NULL otherwise.
+    template <typename T>
+    T* get()
+    {
+        if (m_pAnimation == NULL || m_type != EyeAnimationTypeIndex<T, Animations...>::value)
+            return NULL;
+        return static_cast<T*>(m_pAnimation);
+    }
+
+    // Returns the animation in the slot, whatever its type, or NULL if the slot is empty.
+    EyeAnimationBase* get()
+    {
+        return m_pAnimation;
+    }
+
+protected:
+    void destroy()
+    {
+        if (m_pAnimation)
+            m_pAnimation->~EyeAnimationBase();
+        m_pAnimation = NULL;
+    }
+
+    alignas(EyeAnimationStorage<Animations...>::alignment)
+    uint8_t           m_storage[EyeAnimationStorage<Animations...>::size];
+    EyeMatrices*      m_pEyes;
+    EyeAnimationBase* m_pAnimation;
+    int               m_type;
+};
+
+
 // This animation blinks the eyes.
 class BlinkAnimation : public EyeAnimationBase
 {
@@ -324,6 +760,7 @@ public:
     //  pEyes is a pointer to the EyeMatrices object to be used by the animations to render their eye animations.
     BlinkAnimation(EyeMatrices* pEyes) : EyeAnimationBase(pEyes)
     {
+        m_frameDelay = BLINK_FRAME_DELAY_DEFAULT;
         m_isDone = true;
     }
 
@@ -333,9 +770,28 @@ public:
     }
 
     // Starts an animation which blinks the desired eyes(s).
-    //  leftBlink should be set to true if you want the left eye to blink and false otherwise.
-    //  rightBlink should be set to true if you want the right eye to blink and false otherwise.
-    void start(bool leftBlink = true, bool rightBlink = true);
+    //  leftBlink should be set to true if you want the left eye(s) to blink and false otherwise.
+    //  rightBlink should be set to true if you want the right eye(s) to blink and false otherwise.
+    void start(bool leftBlink = true, bool rightBlink = true)
+    {
+        startEyes((leftBlink ? EyeMatrices::LEFT_EYES_MASK : 0) | (rightBlink ? EyeMatrices::RIGHT_EYES_MASK : 0));
+    }
+
+    // Starts an animation which blinks any combination of eyes.
+    //  eyeMask has a bit set for each eye which should blink. Bit 0 is EyeMatrices::LEFT, bit 1 is
+    //          EyeMatrices::RIGHT, etc.
+    //  delay is the number of milliseconds to wait before the lids start to close. Useful for staggering blinks on
+    //        different EyeAnimationTracks.
+    void startEyes(uint32_t eyeMask, uint32_t delay = 0);
+
+    // Sets how often the blink animation draws a new frame. The position of the lids is based on the time since the
+    // blink started so a blink always takes the same amount of time. Lid positions are just skipped at lower frame
+    // rates and frames where the lids haven't moved aren't drawn at higher ones.
+    //  frameDelay is the number of milliseconds between frames.
+    void setFrameDelay(uint32_t frameDelay)
+    {
+        m_frameDelay = frameDelay;
+    }
 
     // Run the blink animation code.
     virtual void run();
@@ -354,11 +810,15 @@ protected:
         DONE
     };
 
-    int      m_index;
+    uint32_t m_eyeMask;
+    uint32_t m_frameDelay;
+    uint32_t m_phaseStart;
+    int      m_lid;
     State    m_state;
-    bool     m_leftBlink;
-    bool     m_rightBlink;
     bool     m_isDone;
+    // The lids which each eye had before the blink started so that they can be restored once it has completed.
+    uint8_t  m_restUpperLid[EyeMatrices::PUPIL_COUNT];
+    uint8_t  m_restLowerLid[EyeMatrices::PUPIL_COUNT];
 };
 
 
@@ -371,6 +831,7 @@ public:
     //  pEyes is a pointer to the EyeMatrices object to be used by the animations to render their eye animations.
     PupilAnimation(EyeMatrices* pEyes) : EyeAnimationBase(pEyes)
     {
+        m_eyeMask = EyeMatrices::ALL_EYES_MASK;
         m_isDone = true;
     }
 
@@ -384,7 +845,10 @@ public:
     //             the PupilKeyFrames structure to learn more about actions that can be performed as the animation
     //             progresses to each defined keyframe.
     //  keyFrameCount is the number of keyframe elements in the pKeyFrames array.
-    void start(const PupilKeyFrame* pKeyFrames, size_t keyFrameCount);
+    //  eyeMask has a bit set for each eye whose pupil should be moved by the animation. The pupils of the other eyes
+    //          are left wherever they are so that they can be animated by another of the EyeAnimationTracks.
+    void start(const PupilKeyFrame* pKeyFrames, size_t keyFrameCount,
+               uint32_t eyeMask = EyeMatrices::ALL_EYES_MASK);
 
     // Run the animation.
     virtual void run();
@@ -396,18 +860,41 @@ public:
     }
 
 protected:
-    void startNextFrame();
+    // Integer (Bresenham style) state for moving a pupil along one axis without any floating point. error accumulates
+    // increment (twice the pixel distance) on each step and pos moves one pixel in direction each time it reaches
+    // twice the step count. error starts at the step count so that pos is always the nearest pixel to the ideal path.
+    // Eased motions are instead placed at start plus the eased fraction of distance.
+    struct AxisStepper
+    {
+        int pos;
+        int direction;
+        int increment;
+        int error;
+        int start;
+        int distance;
+    };
+
+    void     startNextFrame();
+    void     startAxis(AxisStepper* pAxis, int startPos, int endPos);
+    int      stepAxis(AxisStepper* pAxis);
+    int      easeAxis(const AxisStepper* pAxis);
+    uint32_t calculateStepDelay();
 
     const PupilKeyFrame* m_pFirstKeyFrame;
     const PupilKeyFrame* m_pLastKeyFrame;
     const PupilKeyFrame* m_pCurrKeyFrame;
-    PupilPosition        m_startPos[EyeMatrices::PUPIL_COUNT];
-    float                m_changeX[EyeMatrices::PUPIL_COUNT];
-    float                m_changeY[EyeMatrices::PUPIL_COUNT];
+    AxisStepper          m_axisX[EyeMatrices::PUPIL_COUNT];
+    AxisStepper          m_axisY[EyeMatrices::PUPIL_COUNT];
     int                  m_index;
     int                  m_steps;
-    uint32_t             m_frameDelay;
-    int32_t              m_frameDelayStep;
+    // Progress through an eased motion as a Q16 fraction of its steps. It advances by m_easingFractionStep each step
+    // with the remainder of the division carried in m_easingError so that it lands exactly on EASING_FRACTION_ONE.
+    uint32_t             m_easingFraction;
+    uint32_t             m_easingFractionStep;
+    uint32_t             m_easingRemainder;
+    uint32_t             m_easingError;
+    EasingCurve          m_easing;
+    uint32_t             m_eyeMask;
     bool                 m_isDone;
 };
 
@@ -428,11 +915,14 @@ public:
     }
 
     // Starts the pupil animation to move the pupils for both eyes from their current location to the new location.
-    //  newX is the horizontal offset to which both pupils should be moved. The accepted range is -5 to 5.
-    //  newY is the vertical offset to which both pupils should be moved. The accepted range is -5 to 5.
+    //  newX is the horizontal offset to which both pupils should be moved. The accepted range is MIN to MAX.
+    //  newY is the vertical offset to which both pupils should be moved. The accepted range is MIN to MAX.
     //  stepDelay is the time in milliseconds that the animation should delay between each interpolated frame as the
     //            pupils progress from their current location to their new location.
-    void start(int newX, int newY, uint32_t stepDelay);
+    //  eyeMask has a bit set for each eye whose pupil should be moved.
+    //  easing is the curve the pupils follow as they move.
+    void start(int newX, int newY, uint32_t stepDelay, uint32_t eyeMask = EyeMatrices::ALL_EYES_MASK,
+               EasingCurve easing = EASE_LINEAR);
 
 protected:
     PupilKeyFrame m_keyFrames[1];
@@ -457,9 +947,6 @@ public:
 
     // Starts the cross eye pupil animation.
     void start();
-
-protected:
-    PupilKeyFrame m_keyFrames[5];
 };
 
 
@@ -480,9 +967,6 @@ public:
 
     // Starts the pupils rotating around the eyes.
     void start();
-
-protected:
-    PupilKeyFrame m_keyFrames[2 + 12 * ROUND_SPIN_ITERATIONS];
 };
 
 
@@ -504,9 +988,6 @@ public:
 
     // Starts the pupil spinning.
     void start();
-
-protected:
-    PupilKeyFrame m_keyFrames[2 + 3 * CRAZY_SPIN_ITERATIONS];
 };
 
 
@@ -528,9 +1009,6 @@ public:
 
     // Starts the animation.
     void start();
-
-protected:
-    PupilKeyFrame m_keyFrames[5];
 };
 
 
@@ -551,14 +1029,12 @@ public:
 
     // Starts the lazy eye animation.
     void start();
-
-protected:
-    PupilKeyFrame m_keyFrames[5];
 };
 
 
 // This animation brightens the eyes with the pupil in their current position and then darkens them back down to their
-// original brightness.
+// original brightness. The HT16K33 has no hardware fade so the ramp is a precomputed sequence of brightness commands
+// where each step is a single command write per display. The displays skip the steps which repeat their brightness.
 class GlowEyesAnimation : public EyeAnimationBase
 {
 public:
@@ -566,6 +1042,8 @@ public:
     //  pEyes is a pointer to the EyeMatrices object to be used by the animations to render their eye animations.
     GlowEyesAnimation(EyeMatrices* pEyes) : EyeAnimationBase(pEyes)
     {
+        m_step = 0;
+        m_iterations = 0;
         m_isDone = true;
     }
 
@@ -587,16 +1065,179 @@ public:
         return m_isDone;
     }
 
+protected:
+    int      m_step;
+    int      m_iterations;
+    bool     m_isDone;
+};
+
+
+// This animation flashes the eyes on and off for a while. When the displays support it (HT16K33), the display
+// controllers are told to blink on their own so that only one command is sent to each display to start the flashing and
+// another to stop it. Other displays are flashed in software by closing and opening the lids.
+class FlashEyesAnimation : public EyeAnimationBase
+{
+public:
+    // Constructor
+    //  pEyes is a pointer to the EyeMatrices object to be used by the animations to render their eye animations.
+    FlashEyesAnimation(EyeMatrices* pEyes) : EyeAnimationBase(pEyes)
+    {
+        m_rate = HT16K33_BLINK_OFF;
+        m_duration = 0;
+        m_state = DONE;
+        m_isHardwareBlink = false;
+        m_isDone = true;
+    }
+
+    // Virtual destructor.
+    ~FlashEyesAnimation()
+    {
+    }
+
+    // Starts flashing the eyes.
+    //  rate is how fast the eyes flash: HT16K33_BLINK_2HZ, HT16K33_BLINK_1HZ, or HT16K33_BLINK_HALFHZ.
+    //  duration is the number of milliseconds for which the eyes should flash.
+    void start(uint8_t rate, uint32_t duration);
+
+    // Run the animation.
+    virtual void run();
+
+    // Returns true once the eyes have stopped flashing and false before that.
+    virtual bool isDone()
+    {
+        return m_isDone;
+    }
+
+    // Returns the I2C bytes saved by having the controllers blink the eyes instead of sending a frame to every display
+    // each time the eyes turn on or off. 0 if the eyes had to be flashed in software.
+    virtual uint32_t getI2CBytesSaved();
+
+protected:
+    enum State
+    {
+        STARTING,
+        FLASHING,
+        DONE
+    };
+
+    uint32_t getToggleDelay();
+    void     showEyes(bool isOn);
+
+    uint32_t              m_duration;
+    uint32_t              m_flashStart;
+    State                 m_state;
+    uint8_t               m_rate;
+    bool                  m_isHardwareBlink;
+    bool                  m_isOn;
+    bool                  m_isDone;
+    EyeMatrices::LidShape m_restLidShape[EyeMatrices::PUPIL_COUNT];
+    uint8_t               m_restUpperLid[EyeMatrices::PUPIL_COUNT];
+    uint8_t               m_restLowerLid[EyeMatrices::PUPIL_COUNT];
+};
+
+
+// This animation dilates the pupils up to their largest size and then constricts them back down to their normal size.
+// It just switches between the precomputed frames for each pupil size.
+class DilatePupilsAnimation : public EyeAnimationBase
+{
+public:
+    // Constructor
+    //  pEyes is a pointer to the EyeMatrices object to be used by the animations to render their eye animations.
+    DilatePupilsAnimation(EyeMatrices* pEyes) : EyeAnimationBase(pEyes)
+    {
+        m_isDone = true;
+    }
+
+    // Virtual destructor.
+    ~DilatePupilsAnimation()
+    {
+    }
+
+    // Starts the pupil dilation animation.
+    //  iterations is the number of times to repeat the dilate/constrict animation sequence.
+    void start(int iterations);
+
+    // Run the animation.
+    virtual void run();
+
+    // Returns true once the dilation animation has completed and false before that.
+    virtual bool isDone()
+    {
+        return m_isDone;
+    }
+
 protected:
     enum State
     {
-        BRIGHTER,
-        DARKER,
+        DILATING,
+        CONSTRICTING,
         DONE
     };
 
-    int      m_brightness;
+    int      m_size;
     int      m_iterations;
     State    m_state;
     bool     m_isDone;
 };
+
+
+// This animation moves the lids of all the eyes into one of a few facial expressions, holds it and then opens the lids
+// back up again.
+class ExpressionAnimation : public EyeAnimationBase
+{
+public:
+    enum Expression
+    {
+        HALF_LIDDED,
+        ANGRY,
+        SAD,
+        SQUINT,
+        EXPRESSION_COUNT
+    };
+
+    // Constructor
+    //  pEyes is a pointer to the EyeMatrices object to be used by the animations to render their eye animations.
+    ExpressionAnimation(EyeMatrices* pEyes) : EyeAnimationBase(pEyes)
+    {
+        m_isDone = true;
+    }
+
+    // Virtual destructor.
+    ~ExpressionAnimation()
+    {
+    }
+
+    // Starts the expression animation.
+    //  expression is the expression that the lids should be moved into.
+    //  holdTime is the number of milliseconds to hold the expression before opening the lids again.
+    void start(Expression expression, uint32_t holdTime);
+
+    // Run the animation.
+    virtual void run();
+
+    // Returns true once the expression animation has completed and false before that.
+    virtual bool isDone()
+    {
+        return m_isDone;
+    }
+
+protected:
+    enum State
+    {
+        LIDS_CLOSING,
+        HOLDING,
+        LIDS_OPENING,
+        DONE
+    };
+
+    void drawLids();
+
+    EyeMatrices::LidShape m_shape;
+    int                   m_upperTarget;
+    int                   m_lowerTarget;
+    int                   m_upperLid;
+    int                   m_lowerLid;
+    uint32_t              m_holdTime;
+    State                 m_state;
+    bool                  m_isDone;
+};
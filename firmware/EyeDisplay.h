@@ -0,0 +1,264 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Display backends used by EyeMatrices to show each 8x8 tile of the eyes. */
+#ifndef EYE_DISPLAY_H_
+#define EYE_DISPLAY_H_
+
+#include <stdint.h>
+#include "Adafruit_LEDBackpack.h"
+#include "Bitboard.h"
+#include "I2CAsync.h"
+
+
+// The most bit planes that can be passed to IEyeDisplay::setGrayscaleFrame(). 3 planes give 8 levels per pixel.
+#define EYE_DISPLAY_MAX_PLANES  3
+
+
+// The interface that EyeMatrices renders each 8x8 tile of its eyes through. Whole frames are submitted at once and then
+// sent to the hardware by flush() so that a backend can batch up its writes however best suits its bus.
+class IEyeDisplay
+{
+public:
+    virtual ~IEyeDisplay()
+    {
+    }
+
+    // Sets the 8x8 image to be shown on the next flush().
+    //  bitboard is the image to be displayed. See Bitboard.h for its format.
+    virtual void setFrame(uint64_t bitboard) = 0;
+
+    // Sets a grayscale image to be shown on the next flush(). Backends which can only show monochrome images just show
+    // the pixels which are at least half brightness.
+    //  pPlanes points to an array of planeCount bitboards, one for each bit of the pixel levels. pPlanes[0] holds the
+    //          least significant bit of each pixel's level.
+    //  planeCount is the number of bit planes in pPlanes (1 - EYE_DISPLAY_MAX_PLANES).
+    virtual void setGrayscaleFrame(const uint64_t* pPlanes, int planeCount)
+    {
+        setFrame(pPlanes[planeCount - 1]);
+    }
+
+    // Tells the display which pixels of the frames to follow are turned off because they are covered by the eye lids,
+    // rather than being part of the pupil. Backends which colour in the eye use it to draw the lids. The others can
+    // ignore it since those pixels are already turned off in the frames.
+    //  lids is a bitboard with the pixels covered by the lids set.
+    virtual void setLidMask(uint64_t lids)
+    {
+    }
+
+    // Sets the brightness of the whole display. It takes effect no later than the next flush().
+    //  brightness is the desired brightness. Allowed values are between 0 (BRIGHTNESS_MIN) and 15 (BRIGHTNESS_MAX).
+    virtual void setBrightness(uint8_t brightness) = 0;
+
+    // Has the display controller blink the whole display on its own, without any further frames having to be sent.
+    // Backends without hardware blink support return false and leave the display as it was so that the caller can
+    // blink it in software instead.
+    //  rate is one of HT16K33_BLINK_OFF, HT16K33_BLINK_2HZ, HT16K33_BLINK_1HZ, or HT16K33_BLINK_HALFHZ.
+    virtual bool setBlinkRate(uint8_t rate)
+    {
+        return false;
+    }
+
+    // Starts sending any frame and brightness changes made since the last flush() to the hardware. Shouldn't block
+    // waiting for the hardware to accept them.
+    virtual void flush() = 0;
+};
+
+
+// Eye displayed on an Adafruit 8x8 matrix backpack (HT16K33) attached to an I2CAsync bus.
+class HT16K33EyeDisplay : public IEyeDisplay
+{
+public:
+    // Initializes the HT16K33 and sets its brightness to its lowest setting.
+    //  pI2C is a pointer to the I2CAsync bus object to which the matrix has been attached.
+    //  i2cAddress is the 7-bit I2C address of the matrix.
+    void begin(I2CAsync* pI2C, uint8_t i2cAddress)
+    {
+        m_matrix.begin(pI2C, i2cAddress);
+        m_matrix.setBrightness(0);
+    }
+
+    // Returns the counters for all of the I2C traffic sent to this matrix.
+    const I2CDeviceStats* getStats()
+    {
+        return m_matrix.getStats();
+    }
+
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t bitboard)
+    {
+        m_matrix.drawBitboard(bitboard);
+    }
+    virtual void setBrightness(uint8_t brightness)
+    {
+        m_matrix.setBrightness(brightness);
+    }
+    virtual bool setBlinkRate(uint8_t rate)
+    {
+        m_matrix.blinkRate(rate);
+        return true;
+    }
+    virtual void flush()
+    {
+        m_matrix.writeDisplay();
+    }
+
+protected:
+    Adafruit_8x8matrix m_matrix;
+};
+
+
+// One 8x8 tile of a larger eye displayed on half of an Adafruit 16x8 matrix backpack (HT16K33). A 16x16 eye uses two
+// backpacks, one above the other, with the top backpack holding tiles 0 and 1. The backpack's begin() method should
+// have already been called.
+class HT16K33HalfEyeDisplay : public IEyeDisplay
+{
+public:
+    HT16K33HalfEyeDisplay()
+    {
+        m_pMatrix = NULL;
+        m_half = 0;
+    }
+
+    // Attaches this tile to a half of the backpack.
+    //  pMatrix is a pointer to the backpack which displays this tile.
+    //  half is 0 for the left half of the backpack or 1 for the right half.
+    void begin(Adafruit_16x8matrix* pMatrix, int half)
+    {
+        m_pMatrix = pMatrix;
+        m_half = half;
+    }
+
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t bitboard)
+    {
+        m_pMatrix->drawBitboard(m_half, bitboard);
+    }
+    virtual void setBrightness(uint8_t brightness)
+    {
+        // Both halves set the same brightness and the backpack skips the repeat so it is only sent once.
+        m_pMatrix->setBrightness(brightness);
+    }
+    virtual bool setBlinkRate(uint8_t rate)
+    {
+        // The blink rate is shared by both halves too.
+        m_pMatrix->blinkRate(rate);
+        return true;
+    }
+    virtual void flush()
+    {
+        // Both halves share the backpack's display RAM so the first flush sends the changes made to either of them.
+        m_pMatrix->writeDisplay();
+    }
+
+protected:
+    Adafruit_16x8matrix* m_pMatrix;
+    int                  m_half;
+};
+
+// Eye which is only displayed in memory. Useful for tests and benchmarks which want to check what would have been
+// sent to the hardware.
+class MemoryEyeDisplay : public IEyeDisplay
+{
+public:
+    MemoryEyeDisplay()
+    {
+        m_pendingFrame = 0;
+        m_frame = 0;
+        m_lids = 0;
+        m_frameCount = 0;
+        m_flushCount = 0;
+        m_brightness = 0;
+    }
+
+    // Returns the image as of the last flush().
+    uint64_t getFrame()
+    {
+        return m_frame;
+    }
+
+    // Returns the pixels covered by the lids, as most recently passed to setLidMask().
+    uint64_t getLidMask()
+    {
+        return m_lids;
+    }
+
+    // Returns the most recently set brightness.
+    uint8_t getBrightness()
+    {
+        return m_brightness;
+    }
+
+    // Returns the number of times that flush() has sent a different frame than the one before it.
+    uint32_t getFrameCount()
+    {
+        return m_frameCount;
+    }
+
+    // Returns the number of times that flush() has been called.
+    uint32_t getFlushCount()
+    {
+        return m_flushCount;
+    }
+
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t bitboard)
+    {
+        m_pendingFrame = bitboard;
+    }
+    virtual void setLidMask(uint64_t lids)
+    {
+        m_lids = lids;
+    }
+    virtual void setBrightness(uint8_t brightness)
+    {
+        m_brightness = brightness;
+    }
+    virtual void flush()
+    {
+        if (m_pendingFrame != m_frame)
+        {
+            m_frame = m_pendingFrame;
+            m_frameCount++;
+        }
+        m_flushCount++;
+    }
+
+protected:
+    uint64_t m_pendingFrame;
+    uint64_t m_frame;
+    uint64_t m_lids;
+    uint32_t m_frameCount;
+    uint32_t m_flushCount;
+    uint8_t  m_brightness;
+};
+
+
+// Eye which isn't displayed at all. Used to measure how much CPU the eye animations take on their own.
+class NullEyeDisplay : public IEyeDisplay
+{
+public:
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t)
+    {
+    }
+    virtual void setBrightness(uint8_t)
+    {
+    }
+    virtual void flush()
+    {
+    }
+};
+
+#endif // EYE_DISPLAY_H_
@@ -156,9 +156,13 @@ int removeDmaInterruptHandler(DmaInterruptHandler* pHandler)
 
 
 static void initDmaMemCopy(void);
+static void startDmaMemCopyChunk(void);
 static uint32_t dmaMemCopyInterruptHandler(void* pContext, uint32_t dmaInterruptStatus);
 
 static const DmaMemCopyCallback* g_pMemCopyCallback = NULL;
+static uint8_t*                  g_pMemCopyDest;
+static const uint8_t*            g_pMemCopySrc;
+static size_t                    g_memCopyRemaining;
 static LPC_GPDMACH_TypeDef*      g_pChannelMemCopy = NULL;
 static uint32_t                  g_channelMemCopy;
 static int                       g_haveInitForMemCopy = 0;
@@ -174,26 +178,10 @@ int dmaMemCopy(void* pDest, const void* pSrc, size_t size, const DmaMemCopyCallb
     {
         // Kick off the DMA transfer to perform the copy since the DMA channel is free.
         g_pMemCopyCallback = pCallback;
-        uint32_t memcopyChannelMask = 1 << g_channelMemCopy;
-
-        LPC_GPDMA->DMACIntTCClear = memcopyChannelMask;
-        LPC_GPDMA->DMACIntErrClr  = memcopyChannelMask;
-
-        g_pChannelMemCopy->DMACCSrcAddr  = (uint32_t)pSrc;
-        g_pChannelMemCopy->DMACCDestAddr = (uint32_t)pDest;
-        g_pChannelMemCopy->DMACCLLI      = 0;
-        g_pChannelMemCopy->DMACCControl  = DMACCxCONTROL_I | DMACCxCONTROL_SI | DMACCxCONTROL_DI |
-                         (DMACCxCONTROL_WIDTH_WORD << DMACCxCONTROL_SWIDTH_SHIFT) |
-                         (DMACCxCONTROL_WIDTH_WORD << DMACCxCONTROL_DWIDTH_SHIFT) |
-                         (DMACCxCONTROL_BURSTSIZE_1 << DMACCxCONTROL_SBSIZE_SHIFT) |
-                         (DMACCxCONTROL_BURSTSIZE_1 << DMACCxCONTROL_DBSIZE_SHIFT) |
-                         (size & DMACCxCONTROL_TRANSFER_SIZE_MASK);
-
-        // Enable DMA memory copy channel.
-        g_pChannelMemCopy->DMACCConfig = DMACCxCONFIG_ENABLE |
-                       DMACCxCONFIG_TRANSFER_TYPE_M2M |
-                       DMACCxCONFIG_IE |
-                       DMACCxCONFIG_ITC;
+        g_pMemCopyDest = (uint8_t*)pDest;
+        g_pMemCopySrc = (const uint8_t*)pSrc;
+        g_memCopyRemaining = size;
+        startDmaMemCopyChunk();
 
         return 1;
     }
@@ -223,6 +211,48 @@ static void initDmaMemCopy(void)
     g_haveInitForMemCopy = 1;
 }
 
+static void startDmaMemCopyChunk(void)
+{
+    uint32_t memcopyChannelMask = 1 << g_channelMemCopy;
+    uint32_t width = DMACCxCONTROL_WIDTH_BYTE;
+    uint32_t widthShift = 0;
+    uint32_t transferCount;
+
+    // The transfer size is a count of source width units and is limited to 4095 of them so large copies are split
+    // into multiple chunks. Copy a word at a time when everything is word aligned.
+    if ((((uint32_t)g_pMemCopyDest | (uint32_t)g_pMemCopySrc | g_memCopyRemaining) & 3) == 0)
+    {
+        width = DMACCxCONTROL_WIDTH_WORD;
+        widthShift = 2;
+    }
+    transferCount = g_memCopyRemaining >> widthShift;
+    if (transferCount > DMACCxCONTROL_TRANSFER_SIZE_MASK)
+        transferCount = DMACCxCONTROL_TRANSFER_SIZE_MASK;
+
+    LPC_GPDMA->DMACIntTCClear = memcopyChannelMask;
+    LPC_GPDMA->DMACIntErrClr  = memcopyChannelMask;
+
+    g_pChannelMemCopy->DMACCSrcAddr  = (uint32_t)g_pMemCopySrc;
+    g_pChannelMemCopy->DMACCDestAddr = (uint32_t)g_pMemCopyDest;
+    g_pChannelMemCopy->DMACCLLI      = 0;
+    g_pChannelMemCopy->DMACCControl  = DMACCxCONTROL_I | DMACCxCONTROL_SI | DMACCxCONTROL_DI |
+                     (width << DMACCxCONTROL_SWIDTH_SHIFT) |
+                     (width << DMACCxCONTROL_DWIDTH_SHIFT) |
+                     (DMACCxCONTROL_BURSTSIZE_1 << DMACCxCONTROL_SBSIZE_SHIFT) |
+                     (DMACCxCONTROL_BURSTSIZE_1 << DMACCxCONTROL_DBSIZE_SHIFT) |
+                     transferCount;
+
+    g_pMemCopyDest += transferCount << widthShift;
+    g_pMemCopySrc += transferCount << widthShift;
+    g_memCopyRemaining -= transferCount << widthShift;
+
+    // Enable DMA memory copy channel.
+    g_pChannelMemCopy->DMACCConfig = DMACCxCONFIG_ENABLE |
+                   DMACCxCONFIG_TRANSFER_TYPE_M2M |
+                   DMACCxCONFIG_IE |
+                   DMACCxCONFIG_ITC;
+}
+
 uint32_t dmaMemCopyInterruptHandler(void* pContext, uint32_t dmaInterruptStatus)
 {
     uint32_t memcopyChannelMask = 1 << g_channelMemCopy;
@@ -232,6 +262,13 @@ uint32_t dmaMemCopyInterruptHandler(void* pContext, uint32_t dmaInterruptStatus)
         return 0;
     }
 
+    if (g_memCopyRemaining > 0)
+    {
+        // Start copying the next chunk of a large copy.
+        startDmaMemCopyChunk();
+        return memcopyChannelMask;
+    }
+
     // Callback into the client application to let them know that the memcpy has completed.
     assert ( g_pMemCopyCallback );
     g_pMemCopyCallback->handler(g_pMemCopyCallback->pContext);
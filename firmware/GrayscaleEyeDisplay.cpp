@@ -0,0 +1,160 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <assert.h>
+#include <mbed.h>
+#include "GrayscaleEyeDisplay.h"
+
+
+HT16K33GrayscaleEyeDisplay::HT16K33GrayscaleEyeDisplay()
+{
+    memset(m_pendingPlanes, 0, sizeof(m_pendingPlanes));
+    memset(m_flushedPlanes, 0, sizeof(m_flushedPlanes));
+    memset(m_planes, 0, sizeof(m_planes));
+    m_basePeriod = GRAYSCALE_DEFAULT_BASE_PERIOD;
+    m_planeStartTime = 0;
+    m_writeStartTime = 0;
+    m_cycleStartTime = 0;
+    m_lastCyclePeriod = 0;
+    m_overrunCount = 0;
+    m_goodCycles = 0;
+    m_planeCount = EYE_DISPLAY_MAX_PLANES;
+    m_firstPlane = 0;
+    m_currPlane = 0;
+    m_isCycleOverrun = false;
+    m_isWriting = false;
+    m_isStarted = false;
+}
+
+void HT16K33GrayscaleEyeDisplay::begin(I2CAsync* pI2C, uint8_t i2cAddress, int planeCount, uint32_t basePeriod)
+{
+    assert ( planeCount >= 1 && planeCount <= EYE_DISPLAY_MAX_PLANES );
+
+    m_matrix.begin(pI2C, i2cAddress);
+    m_matrix.setBrightness(0);
+
+    m_planeCount = planeCount;
+    m_basePeriod = basePeriod;
+    m_firstPlane = 0;
+    m_isStarted = true;
+    startNextCycle(us_ticker_read());
+}
+
+void HT16K33GrayscaleEyeDisplay::setFrame(uint64_t bitboard)
+{
+    // A monochrome frame is just every plane of every lit pixel turned on.
+    for (int plane = 0 ; plane < m_planeCount ; plane++)
+    {
+        m_pendingPlanes[plane] = bitboard;
+    }
+}
+
+void HT16K33GrayscaleEyeDisplay::setGrayscaleFrame(const uint64_t* pPlanes, int planeCount)
+{
+    assert ( planeCount >= 1 && planeCount <= EYE_DISPLAY_MAX_PLANES );
+
+    // Line up the most significant planes of the image with those of the display. Extra low planes in the image are
+    // dropped and missing ones are filled in with the lowest plane provided.
+    for (int plane = m_planeCount - 1, src = planeCount - 1 ; plane >= 0 ; plane--, src--)
+    {
+        m_pendingPlanes[plane] = pPlanes[src >= 0 ? src : 0];
+    }
+}
+
+void HT16K33GrayscaleEyeDisplay::setBrightness(uint8_t brightness)
+{
+    m_matrix.setBrightness(brightness);
+}
+
+bool HT16K33GrayscaleEyeDisplay::setBlinkRate(uint8_t rate)
+{
+    // The blink register gates the LED drivers so it blinks whichever bit plane is currently being shown.
+    m_matrix.blinkRate(rate);
+    return true;
+}
+
+void HT16K33GrayscaleEyeDisplay::flush()
+{
+    // refresh() will start showing the new frame at the beginning of the next cycle.
+    memcpy(m_flushedPlanes, m_pendingPlanes, sizeof(m_flushedPlanes));
+}
+
+void HT16K33GrayscaleEyeDisplay::refresh()
+{
+    if (!m_isStarted)
+        return;
+
+    uint32_t currTime = us_ticker_read();
+    if (m_isWriting)
+    {
+        // The plane isn't shown until its write has made it out on the bus.
+        I2CTransferStatus status = m_matrix.getDisplayStatus();
+        if (status == I2C_TRANSFER_QUEUED || status == I2C_TRANSFER_ACTIVE)
+            return;
+        m_isWriting = false;
+        m_planeStartTime = currTime;
+
+        // A write which takes longer than the shortest plane still being shown distorts the levels. That is the
+        // first plane of the cycle, which gets longer as the less significant planes are dropped.
+        if (currTime - m_writeStartTime > (m_basePeriod << m_firstPlane))
+        {
+            m_overrunCount++;
+            m_isCycleOverrun = true;
+        }
+    }
+
+    // Each plane is shown for twice as long as the one below it.
+    if (currTime - m_planeStartTime < (m_basePeriod << m_currPlane))
+        return;
+    if (m_currPlane + 1 < m_planeCount)
+        startPlane(m_currPlane + 1, currTime);
+    else
+        startNextCycle(currTime);
+}
+
+void HT16K33GrayscaleEyeDisplay::startNextCycle(uint32_t currTime)
+{
+    m_lastCyclePeriod = currTime - m_cycleStartTime;
+    m_cycleStartTime = currTime;
+
+    // Drop the least significant plane if the bus didn't keep up during the last cycle and try it again once the bus
+    // has been keeping up for a while.
+    if (m_isCycleOverrun)
+    {
+        if (getActivePlaneCount() > 1)
+            m_firstPlane++;
+        m_goodCycles = 0;
+    }
+    else if (m_firstPlane > 0 && ++m_goodCycles >= GRAYSCALE_RETRY_CYCLES)
+    {
+        m_firstPlane--;
+        m_goodCycles = 0;
+    }
+    m_isCycleOverrun = false;
+
+    memcpy(m_planes, m_flushedPlanes, sizeof(m_planes));
+    startPlane(m_firstPlane, currTime);
+}
+
+void HT16K33GrayscaleEyeDisplay::startPlane(int plane, uint32_t currTime)
+{
+    // Nothing is sent if the plane is the same as the one already on the matrix, which is always the case when there
+    // is only one plane left.
+    m_currPlane = plane;
+    m_matrix.drawBitboard(m_planes[plane]);
+    m_matrix.writeDisplay();
+    m_writeStartTime = currTime;
+    m_planeStartTime = currTime;
+    m_isWriting = true;
+}
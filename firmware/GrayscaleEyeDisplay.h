@@ -0,0 +1,116 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef GRAYSCALE_EYE_DISPLAY_H_
+#define GRAYSCALE_EYE_DISPLAY_H_
+
+#include <stdint.h>
+#include "Adafruit_LEDBackpack.h"
+#include "EyeDisplay.h"
+#include "I2CAsync.h"
+
+
+// The default number of microseconds that the least significant bit plane is displayed for. Each higher plane is
+// displayed twice as long as the one below it so 3 planes take 7x this long to refresh.
+#define GRAYSCALE_DEFAULT_BASE_PERIOD   1000
+// The number of refresh cycles without any overruns after which a dropped bit plane will be tried again.
+#define GRAYSCALE_RETRY_CYCLES          512
+
+
+// Eye displayed on an Adafruit 8x8 matrix backpack (HT16K33) with per-pixel grayscale. The HT16K33 can only dim the
+// whole matrix so the grayscale image is split into bit planes which are rapidly alternated on the matrix, each one
+// being shown for twice as long as the one before it.
+// refresh() must be called often from the main loop to switch between the planes. Only the bytes which differ between
+// planes are sent so the I2C load depends on the image. If the bus can't get a plane onto the matrix within the time
+// that the least significant plane being shown should be displayed for then the levels would be distorted so that
+// plane is dropped (halving the number of levels) until the bus has been keeping up for GRAYSCALE_RETRY_CYCLES
+// refresh cycles. With a single plane left, it is just a monochrome display and doesn't use the bus between frame
+// changes.
+class HT16K33GrayscaleEyeDisplay : public IEyeDisplay
+{
+public:
+    HT16K33GrayscaleEyeDisplay();
+
+    // Initializes the HT16K33 and sets its brightness to its lowest setting.
+    //  pI2C is a pointer to the I2CAsync bus object to which the matrix has been attached.
+    //  i2cAddress is the 7-bit I2C address of the matrix.
+    //  planeCount is the number of bit planes to be displayed (1 - EYE_DISPLAY_MAX_PLANES).
+    //  basePeriod is the number of microseconds that the least significant plane should be shown for.
+    void begin(I2CAsync* pI2C, uint8_t i2cAddress, int planeCount = EYE_DISPLAY_MAX_PLANES,
+               uint32_t basePeriod = GRAYSCALE_DEFAULT_BASE_PERIOD);
+
+    // Switches to the next bit plane once the current one has been shown for long enough. Returns immediately if
+    // there is nothing to do yet.
+    void refresh();
+
+    // Returns the number of complete refresh cycles (one pass through all of the bit planes) per second, as measured
+    // over the most recent cycle.
+    uint32_t getRefreshRate()
+    {
+        return m_lastCyclePeriod ? 1000000 / m_lastCyclePeriod : 0;
+    }
+
+    // Returns the number of bit planes currently being displayed. Will be less than the planeCount passed into
+    // begin() while the bus isn't able to keep up.
+    int getActivePlaneCount()
+    {
+        return m_planeCount - m_firstPlane;
+    }
+
+    // Returns the number of times that a bit plane took longer to get onto the matrix than the least significant
+    // plane still being shown is displayed for.
+    uint32_t getOverrunCount()
+    {
+        return m_overrunCount;
+    }
+
+    // Returns the counters for all of the I2C traffic sent to this matrix.
+    const I2CDeviceStats* getStats()
+    {
+        return m_matrix.getStats();
+    }
+
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t bitboard);
+    virtual void setGrayscaleFrame(const uint64_t* pPlanes, int planeCount);
+    virtual void setBrightness(uint8_t brightness);
+    virtual bool setBlinkRate(uint8_t rate);
+    virtual void flush();
+
+protected:
+    void startNextCycle(uint32_t currTime);
+    void startPlane(int plane, uint32_t currTime);
+
+    Adafruit_8x8matrix m_matrix;
+    // The planes set since the last flush(), the ones from the last flush() and the ones being displayed in the
+    // current cycle. New frames only take effect at the start of a cycle so that the planes shown together match.
+    uint64_t           m_pendingPlanes[EYE_DISPLAY_MAX_PLANES];
+    uint64_t           m_flushedPlanes[EYE_DISPLAY_MAX_PLANES];
+    uint64_t           m_planes[EYE_DISPLAY_MAX_PLANES];
+    uint32_t           m_basePeriod;
+    uint32_t           m_planeStartTime;
+    uint32_t           m_writeStartTime;
+    uint32_t           m_cycleStartTime;
+    uint32_t           m_lastCyclePeriod;
+    uint32_t           m_overrunCount;
+    uint32_t           m_goodCycles;
+    int                m_planeCount;
+    int                m_firstPlane;
+    int                m_currPlane;
+    bool               m_isCycleOverrun;
+    bool               m_isWriting;
+    bool               m_isStarted;
+};
+
+#endif // GRAYSCALE_EYE_DISPLAY_H_
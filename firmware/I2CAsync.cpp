@@ -0,0 +1,504 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <assert.h>
+#include <mbed.h>
+#include "I2CAsync.h"
+
+
+// This class drives the I2C controller registers directly from its interrupt handler.
+// It was only coded to work on the LPC1768.
+#ifndef TARGET_LPC176X
+    #error("This I2CAsync class was only coded to work on the LPC1768.")
+#endif
+
+
+// I2CONSET/I2CONCLR bits.
+#define I2C_CON_I2EN    (1 << 6)
+#define I2C_CON_AA      (1 << 2)
+#define I2C_CON_SI      (1 << 3)
+#define I2C_CON_STO     (1 << 4)
+#define I2C_CON_STA     (1 << 5)
+
+// I2STAT values seen by a master transmitter.
+#define I2C_STAT_BUS_ERROR          0x00
+#define I2C_STAT_START              0x08
+#define I2C_STAT_REPEATED_START     0x10
+#define I2C_STAT_SLAW_ACK           0x18
+#define I2C_STAT_SLAW_NAK           0x20
+#define I2C_STAT_DATA_ACK           0x28
+#define I2C_STAT_DATA_NAK           0x30
+#define I2C_STAT_ARBITRATION_LOST   0x38
+
+// I2CPADCFG bits which switch the I2C0 pads between standard and Fast-mode Plus drive.
+#define I2CPADCFG_SDADRV0   (1 << 0)
+#define I2CPADCFG_SCLDRV0   (1 << 2)
+
+// Half of a 100kHz clock period, used when manually clocking the bus during recovery.
+#define RECOVERY_HALF_PERIOD_US 5
+// The number of clocks required to get a slave which is stuck in the middle of a byte to release SDA.
+#define RECOVERY_CLOCK_COUNT    9
+
+
+I2CAsync* I2CAsync::s_pInstances[3];
+
+
+I2CAsync::I2CAsync(PinName sda, PinName scl) : I2C(sda, scl)
+{
+    m_pI2C = _i2c.i2c;
+    m_pHead = NULL;
+    m_pTail = NULL;
+    m_pActive = NULL;
+    m_sda = sda;
+    m_scl = scl;
+    m_byteIndex = 0;
+    m_timeout = I2C_ASYNC_DEFAULT_TIMEOUT;
+    m_activeStartTime = 0;
+    m_retryCount = I2C_ASYNC_DEFAULT_RETRIES;
+    m_retriesLeft = 0;
+
+    uint32_t handler;
+    if (m_pI2C == LPC_I2C0)
+    {
+        m_controller = 0;
+        m_irq = I2C0_IRQn;
+        handler = (uint32_t)__i2c0InterruptHandler;
+    }
+    else if (m_pI2C == LPC_I2C1)
+    {
+        m_controller = 1;
+        m_irq = I2C1_IRQn;
+        handler = (uint32_t)__i2c1InterruptHandler;
+    }
+    else
+    {
+        assert ( m_pI2C == LPC_I2C2 );
+        m_controller = 2;
+        m_irq = I2C2_IRQn;
+        handler = (uint32_t)__i2c2InterruptHandler;
+    }
+
+    // Only one I2CAsync object can own each of the I2C controllers.
+    assert ( s_pInstances[m_controller] == NULL );
+    s_pInstances[m_controller] = this;
+    NVIC_SetVector(m_irq, handler);
+    NVIC_EnableIRQ(m_irq);
+}
+
+I2CAsync::~I2CAsync()
+{
+    flush();
+    NVIC_DisableIRQ(m_irq);
+    s_pInstances[m_controller] = NULL;
+}
+
+int I2CAsync::frequency(int hz)
+{
+    // Don't change the bit timing out from under a write which is already in progress.
+    flush();
+
+    if (hz > I2C_ASYNC_FAST_MODE_PLUS_HZ)
+    {
+        hz = I2C_ASYNC_FAST_MODE_PLUS_HZ;
+    }
+    if (m_controller == 0)
+    {
+        // The I2C0 pads need to be switched to Fast-mode Plus drive strength to run faster than 400kHz.
+        if (hz > I2C_ASYNC_FAST_MODE_HZ)
+        {
+            LPC_PINCON->I2CPADCFG |= I2CPADCFG_SDADRV0 | I2CPADCFG_SCLDRV0;
+        }
+        else
+        {
+            LPC_PINCON->I2CPADCFG &= ~(I2CPADCFG_SDADRV0 | I2CPADCFG_SCLDRV0);
+        }
+    }
+    else if (hz > I2C_ASYNC_FAST_MODE_HZ)
+    {
+        // I2C1 and I2C2 only have standard open drain pads.
+        hz = I2C_ASYNC_FAST_MODE_HZ;
+    }
+
+    I2C::frequency(hz);
+    return hz;
+}
+
+bool I2CAsync::queueWrite(I2CTransfer* pTransfer, int address, const void* pData, size_t length)
+{
+    assert ( length <= I2C_ASYNC_MAX_WRITE_SIZE );
+    if (length > I2C_ASYNC_MAX_WRITE_SIZE)
+    {
+        return false;
+    }
+
+    // Make sure that a stuck write isn't blocking the queue before adding to it.
+    checkTimeout();
+
+    bool wasQueued = true;
+    disableInterrupt();
+    switch (pTransfer->m_status)
+    {
+    case I2C_TRANSFER_QUEUED:
+        // Nothing has been sent yet so a latest wins write can just replace the data sitting in the queue.
+        if (pTransfer->m_latestWins)
+        {
+            uint32_t index = pTransfer->m_sendIndex;
+            memcpy(pTransfer->m_buffers[index], pData, length);
+            pTransfer->m_lengths[index] = length;
+            pTransfer->m_i2cAddress = address;
+        }
+        else
+        {
+            wasQueued = false;
+        }
+        break;
+    case I2C_TRANSFER_ACTIVE:
+        // The previous write is on the bus so stage this one in the other buffer. The interrupt handler will queue it
+        // up again once the active write completes.
+        if (pTransfer->m_latestWins)
+        {
+            assert ( pTransfer->m_i2cAddress == address );
+            uint32_t index = !pTransfer->m_sendIndex;
+            memcpy(pTransfer->m_buffers[index], pData, length);
+            pTransfer->m_lengths[index] = length;
+            if (!pTransfer->m_isResendPending)
+            {
+                pTransfer->m_queueTimes[index] = us_ticker_read();
+            }
+            pTransfer->m_isResendPending = true;
+        }
+        else
+        {
+            wasQueued = false;
+        }
+        break;
+    default:
+        {
+            uint32_t index = pTransfer->m_sendIndex;
+            memcpy(pTransfer->m_buffers[index], pData, length);
+            pTransfer->m_lengths[index] = length;
+            pTransfer->m_i2cAddress = address;
+            pTransfer->m_queueTimes[index] = us_ticker_read();
+            appendToQueue(pTransfer);
+            if (m_pActive == NULL)
+            {
+                startNextTransfer(0);
+            }
+        }
+        break;
+    }
+    enableInterrupt();
+
+    return wasQueued;
+}
+
+void I2CAsync::flush()
+{
+    while (!isIdle())
+    {
+        checkTimeout();
+
+        // Don't hit the memory bus too hard while the interrupt handler is busy sending the queued writes.
+        __NOP();
+        __NOP();
+        __NOP();
+        __NOP();
+        __NOP();
+    }
+}
+
+void I2CAsync::checkTimeout()
+{
+    disableInterrupt();
+    I2CTransfer* pTransfer = m_pActive;
+    if (pTransfer && us_ticker_read() - m_activeStartTime > m_timeout)
+    {
+        if (pTransfer->m_pStats)
+        {
+            pTransfer->m_pStats->timeouts++;
+        }
+        recoverBus();
+        completeActiveTransfer(I2C_TRANSFER_TIMEOUT);
+        startNextTransfer(0);
+    }
+    enableInterrupt();
+}
+
+// The LPC1768 version of mbed encodes each PinName as the address of its GPIO port plus the pin number within
+// that port.
+static LPC_GPIO_TypeDef* gpioPort(PinName pin)
+{
+    return (LPC_GPIO_TypeDef*)((uint32_t)pin & ~0x1F);
+}
+
+static uint32_t gpioMask(PinName pin)
+{
+    return 1 << ((uint32_t)pin & 0x1F);
+}
+
+static volatile uint32_t* pinSelectRegister(PinName pin)
+{
+    uint32_t pinNumber = (uint32_t)pin - (uint32_t)P0_0;
+    return &LPC_PINCON->PINSEL0 + (pinNumber >> 4);
+}
+
+static uint32_t pinSelectShift(PinName pin)
+{
+    uint32_t pinNumber = (uint32_t)pin - (uint32_t)P0_0;
+    return (pinNumber & 0xF) << 1;
+}
+
+static void releaseLine(PinName pin)
+{
+    // The pull-up resistors on the bus take the line high once we stop driving it.
+    gpioPort(pin)->FIODIR &= ~gpioMask(pin);
+}
+
+static void driveLineLow(PinName pin)
+{
+    gpioPort(pin)->FIOCLR = gpioMask(pin);
+    gpioPort(pin)->FIODIR |= gpioMask(pin);
+}
+
+static bool isLineHigh(PinName pin)
+{
+    return (gpioPort(pin)->FIOPIN & gpioMask(pin)) != 0;
+}
+
+void I2CAsync::recoverBus()
+{
+    // Must be called with the I2C interrupt disabled.
+    // Take the pins away from the I2C controller so that they can be driven manually as GPIO.
+    m_pI2C->I2CONCLR = I2C_CON_I2EN | I2C_CON_STA | I2C_CON_SI | I2C_CON_AA;
+    volatile uint32_t* pSdaSelect = pinSelectRegister(m_sda);
+    volatile uint32_t* pSclSelect = pinSelectRegister(m_scl);
+    uint32_t           sdaShift = pinSelectShift(m_sda);
+    uint32_t           sclShift = pinSelectShift(m_scl);
+    uint32_t           sdaFunction = *pSdaSelect & (3 << sdaShift);
+    uint32_t           sclFunction = *pSclSelect & (3 << sclShift);
+    releaseLine(m_sda);
+    releaseLine(m_scl);
+    *pSdaSelect &= ~(3 << sdaShift);
+    *pSclSelect &= ~(3 << sclShift);
+
+    // A slave which was in the middle of sending a byte when things went wrong can be holding SDA low. Clock SCL
+    // until it finishes the byte and lets go of SDA.
+    for (int i = 0 ; i < RECOVERY_CLOCK_COUNT && !isLineHigh(m_sda) ; i++)
+    {
+        driveLineLow(m_scl);
+        wait_us(RECOVERY_HALF_PERIOD_US);
+        releaseLine(m_scl);
+        wait_us(RECOVERY_HALF_PERIOD_US);
+    }
+
+    // Finish with a STOP condition (SDA rising while SCL is high) to reset the state machine of every slave.
+    driveLineLow(m_scl);
+    wait_us(RECOVERY_HALF_PERIOD_US);
+    driveLineLow(m_sda);
+    wait_us(RECOVERY_HALF_PERIOD_US);
+    releaseLine(m_scl);
+    wait_us(RECOVERY_HALF_PERIOD_US);
+    releaseLine(m_sda);
+    wait_us(RECOVERY_HALF_PERIOD_US);
+
+    // Hand the pins back to the I2C controller.
+    *pSdaSelect |= sdaFunction;
+    *pSclSelect |= sclFunction;
+    m_pI2C->I2CONSET = I2C_CON_I2EN;
+}
+
+void I2CAsync::disableInterrupt()
+{
+    NVIC_DisableIRQ(m_irq);
+}
+
+void I2CAsync::enableInterrupt()
+{
+    NVIC_EnableIRQ(m_irq);
+}
+
+void I2CAsync::appendToQueue(I2CTransfer* pTransfer)
+{
+    pTransfer->m_status = I2C_TRANSFER_QUEUED;
+    pTransfer->m_pNext = NULL;
+    if (m_pTail)
+    {
+        m_pTail->m_pNext = pTransfer;
+    }
+    else
+    {
+        m_pHead = pTransfer;
+    }
+    m_pTail = pTransfer;
+}
+
+void I2CAsync::startNextTransfer(uint32_t conset)
+{
+    // Must be called with the I2C interrupt disabled or from within the interrupt handler itself.
+    I2CTransfer* pNext = m_pHead;
+    if (pNext)
+    {
+        m_pHead = pNext->m_pNext;
+        if (m_pHead == NULL)
+        {
+            m_pTail = NULL;
+        }
+        pNext->m_pNext = NULL;
+        pNext->m_status = I2C_TRANSFER_ACTIVE;
+
+        m_activeStartTime = us_ticker_read();
+        m_byteIndex = 0;
+        m_retriesLeft = m_retryCount;
+        conset |= I2C_CON_STA;
+    }
+    m_pActive = pNext;
+
+    // Setting both STO and STA will send a STOP for the previous write, followed by the START for the next one.
+    if (conset)
+    {
+        m_pI2C->I2CONSET = conset;
+    }
+}
+
+void I2CAsync::completeActiveTransfer(I2CTransferStatus status)
+{
+    I2CTransfer* pTransfer = m_pActive;
+
+    m_pActive = NULL;
+    I2CDeviceStats* pStats = pTransfer->m_pStats;
+    if (pStats && status == I2C_TRANSFER_COMPLETE)
+    {
+        uint32_t latency = us_ticker_read() - pTransfer->m_queueTimes[pTransfer->m_sendIndex];
+        pStats->completed++;
+        if (latency > pStats->maxLatency)
+        {
+            pStats->maxLatency = latency;
+        }
+    }
+
+    if (pTransfer->m_isResendPending && status == I2C_TRANSFER_COMPLETE)
+    {
+        // A newer latest wins write was staged while this one was on the bus so send it next.
+        pTransfer->m_isResendPending = false;
+        pTransfer->m_sendIndex = !pTransfer->m_sendIndex;
+        appendToQueue(pTransfer);
+    }
+    else
+    {
+        // A write which failed drops any newer write staged behind it, rather than sending it to a device which isn't
+        // responding, so that the failure is reported back to the client. The staged write only holds the changes
+        // made since this one so the client needs to send both again anyway.
+        pTransfer->m_isResendPending = false;
+        pTransfer->m_status = status;
+    }
+}
+
+void I2CAsync::__i2c0InterruptHandler()
+{
+    s_pInstances[0]->interruptHandler();
+}
+
+void I2CAsync::__i2c1InterruptHandler()
+{
+    s_pInstances[1]->interruptHandler();
+}
+
+void I2CAsync::__i2c2InterruptHandler()
+{
+    s_pInstances[2]->interruptHandler();
+}
+
+void I2CAsync::interruptHandler()
+{
+    I2CTransfer* pTransfer = m_pActive;
+    uint32_t     status = m_pI2C->I2STAT;
+    uint32_t     conclr = I2C_CON_SI;
+
+    if (pTransfer == NULL)
+    {
+        // Shouldn't be any bus activity without an active transfer so just make sure that the bus is released.
+        m_pI2C->I2CONSET = I2C_CON_STO;
+        m_pI2C->I2CONCLR = I2C_CON_SI | I2C_CON_STA;
+        return;
+    }
+
+    uint32_t        index = pTransfer->m_sendIndex;
+    I2CDeviceStats* pStats = pTransfer->m_pStats;
+    switch (status)
+    {
+    case I2C_STAT_START:
+    case I2C_STAT_REPEATED_START:
+        // Send the address of the device being written.
+        m_pI2C->I2DAT = pTransfer->m_i2cAddress & 0xFE;
+        conclr |= I2C_CON_STA;
+        if (pStats)
+        {
+            pStats->bytesSent++;
+        }
+        break;
+    case I2C_STAT_SLAW_ACK:
+    case I2C_STAT_DATA_ACK:
+        if (m_byteIndex < pTransfer->m_lengths[index])
+        {
+            m_pI2C->I2DAT = pTransfer->m_buffers[index][m_byteIndex++];
+            if (pStats)
+            {
+                pStats->bytesSent++;
+            }
+        }
+        else
+        {
+            completeActiveTransfer(I2C_TRANSFER_COMPLETE);
+            startNextTransfer(I2C_CON_STO);
+        }
+        break;
+    case I2C_STAT_SLAW_NAK:
+    case I2C_STAT_DATA_NAK:
+        if (pStats)
+        {
+            pStats->naks++;
+        }
+        if (m_retriesLeft > 0)
+        {
+            // Release the bus and then start this same write again from the beginning.
+            if (pStats)
+            {
+                pStats->retries++;
+            }
+            m_retriesLeft--;
+            m_byteIndex = 0;
+            m_pI2C->I2CONSET = I2C_CON_STO | I2C_CON_STA;
+        }
+        else
+        {
+            completeActiveTransfer(I2C_TRANSFER_NAK);
+            startNextTransfer(I2C_CON_STO);
+        }
+        break;
+    case I2C_STAT_ARBITRATION_LOST:
+        // Another master won the bus so start over once the bus is free again.
+        m_byteIndex = 0;
+        m_pI2C->I2CONSET = I2C_CON_STA;
+        break;
+    case I2C_STAT_BUS_ERROR:
+    default:
+        // Setting STO in the bus error state just resets the controller, nothing is sent on the bus.
+        completeActiveTransfer(I2C_TRANSFER_BUS_ERROR);
+        startNextTransfer(I2C_CON_STO);
+        break;
+    }
+
+    // Flag that we have handled this interrupt.
+    m_pI2C->I2CONCLR = conclr;
+}
@@ -0,0 +1,239 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef I2C_ASYNC_H_
+#define I2C_ASYNC_H_
+
+#include <mbed.h>
+
+
+// The maximum number of bytes that can be sent in a single queued write. This is large enough to hold the command byte
+// and the 16 bytes of display RAM used by the HT16K33.
+#define I2C_ASYNC_MAX_WRITE_SIZE    17
+// The default number of times that a write will be retried after being NAKed by the device before giving up on it.
+#define I2C_ASYNC_DEFAULT_RETRIES   3
+// The default number of microseconds that a write can be on the bus before it is given up on and the bus is reset.
+// The longest write of 17 bytes takes ~1.7ms at 100kHz so this leaves plenty of room for retries and clock stretching.
+#define I2C_ASYNC_DEFAULT_TIMEOUT   10000
+// The fastest bus frequency supported by the standard I2C pads. Only I2C0 has the Fast-mode Plus pads which can be
+// driven up to 1MHz.
+#define I2C_ASYNC_FAST_MODE_HZ      400000
+#define I2C_ASYNC_FAST_MODE_PLUS_HZ 1000000
+
+
+enum I2CTransferStatus
+{
+    // The transfer has never been queued.
+    I2C_TRANSFER_IDLE,
+    // The transfer is sitting in the queue, waiting for the bus to become free.
+    I2C_TRANSFER_QUEUED,
+    // The transfer is currently being sent out on the bus.
+    I2C_TRANSFER_ACTIVE,
+    // The transfer was successfully sent and ACKed by the device.
+    I2C_TRANSFER_COMPLETE,
+    // The device NAKed the transfer and it still failed after all retries were exhausted.
+    I2C_TRANSFER_NAK,
+    // The I2C controller reported a bus error during the transfer.
+    I2C_TRANSFER_BUS_ERROR,
+    // The transfer didn't complete in time, probably because the bus was stuck. The bus has been reset.
+    I2C_TRANSFER_TIMEOUT
+};
+
+
+// Counters which track the I2C traffic to a single device. Each I2CTransfer used to talk to the device can point to
+// the same I2CDeviceStats object so that they are all accumulated in one place.
+struct I2CDeviceStats
+{
+    // Number of bytes placed on the bus, including the address bytes and any bytes resent because of retries.
+    uint32_t bytesSent;
+    // Number of writes which completed successfully.
+    uint32_t completed;
+    // Number of times that the device NAKed an address or data byte.
+    uint32_t naks;
+    // Number of times that a write was restarted after a NAK.
+    uint32_t retries;
+    // Number of writes which were abandoned because they didn't complete within the timeout.
+    uint32_t timeouts;
+    // The longest time, in microseconds, between a write being queued and it completing.
+    uint32_t maxLatency;
+    // Number of writes which the device's driver didn't queue because they wouldn't have changed anything on it.
+    uint32_t skipped;
+};
+
+
+// An I2C write to be queued up on an I2CAsync bus. The client owns the object and it must stay alive until the write
+// has completed. Each object can only be in the queue once so a client typically allocates one I2CTransfer for each
+// type of write that it issues to a device (display data, brightness, etc).
+class I2CTransfer
+{
+public:
+    // Constructor
+    //  latestWins should be set to true if a new write to this transfer should just replace the data of a previous
+    //             write which hasn't been sent yet. This is useful for things like display updates where only the
+    //             latest frame matters. When false, a new write will be rejected until the previous one has completed.
+    I2CTransfer(bool latestWins = true)
+    {
+        m_pNext = NULL;
+        m_lengths[0] = 0;
+        m_lengths[1] = 0;
+        m_i2cAddress = 0;
+        m_sendIndex = 0;
+        m_status = I2C_TRANSFER_IDLE;
+        m_isResendPending = false;
+        m_latestWins = latestWins;
+        m_pStats = NULL;
+        m_queueTimes[0] = 0;
+        m_queueTimes[1] = 0;
+    }
+
+    // Sets the statistics object to be updated as this transfer's writes are sent on the bus. Can be NULL.
+    void setStats(I2CDeviceStats* pStats)
+    {
+        m_pStats = pStats;
+    }
+
+    // Returns the status of the most recently queued write.
+    I2CTransferStatus getStatus()
+    {
+        return m_status;
+    }
+
+    // Returns true if the write is still waiting in the queue or being sent out on the bus.
+    bool isBusy()
+    {
+        I2CTransferStatus status = m_status;
+        return status == I2C_TRANSFER_QUEUED || status == I2C_TRANSFER_ACTIVE;
+    }
+
+    // Returns true if the data from the most recent write hasn't started going out on the bus yet. A latest wins write
+    // issued now would replace that data before it was ever sent.
+    bool isUnsent()
+    {
+        return m_status == I2C_TRANSFER_QUEUED || m_isResendPending;
+    }
+
+    // Returns true if the most recent write was given up on because of NAKs, a bus error or a timeout.
+    bool hasFailed()
+    {
+        I2CTransferStatus status = m_status;
+        return status == I2C_TRANSFER_NAK || status == I2C_TRANSFER_BUS_ERROR || status == I2C_TRANSFER_TIMEOUT;
+    }
+
+protected:
+    friend class I2CAsync;
+
+    I2CTransfer*               m_pNext;
+    I2CDeviceStats*            m_pStats;
+    // The us_ticker_read() time at which the data in each of the buffers was first queued up.
+    uint32_t                   m_queueTimes[2];
+    // Two buffers are used so that a latest wins write can be staged while the previous one is still on the bus.
+    uint8_t                    m_buffers[2][I2C_ASYNC_MAX_WRITE_SIZE];
+    uint8_t                    m_lengths[2];
+    uint8_t                    m_i2cAddress;
+    volatile uint8_t           m_sendIndex;
+    volatile I2CTransferStatus m_status;
+    volatile bool              m_isResendPending;
+    bool                       m_latestWins;
+};
+
+
+// Interrupt driven I2C master which queues up writes and sends them out in the background so that the caller doesn't
+// need to stall while waiting for the bytes to be clocked out on the bus.
+// It was only coded to work on the LPC1768. The I2C base class is only used to claim the pins and the controller so
+// it is inherited protected. Its blocking read(), write(), start() and stop() methods would fight the interrupt
+// handler for the controller.
+class I2CAsync : protected I2C
+{
+public:
+    // Constructor
+    //  sda is the pin connected to the I2C data line.
+    //  scl is the pin connected to the I2C clock line.
+    I2CAsync(PinName sda, PinName scl);
+    ~I2CAsync();
+
+    // Sets the I2C bus frequency in Hz. Waits for any queued writes to complete before making the change.
+    // Frequencies above 400kHz (up to 1MHz Fast-mode Plus) are only supported on I2C0 (P0.27/P0.28) since it is the
+    // only controller with Fast-mode Plus pads. The frequency is limited to 400kHz on the other controllers.
+    //  Returns the frequency that was actually used.
+    int frequency(int hz);
+
+    // Sets the number of times a NAKed write will be retried before it is failed with I2C_TRANSFER_NAK.
+    void setRetryCount(uint8_t retryCount)
+    {
+        m_retryCount = retryCount;
+    }
+
+    // Sets the number of microseconds a write can take, including any retries, before it is abandoned with
+    // I2C_TRANSFER_TIMEOUT and the bus is reset.
+    void setTimeout(uint32_t timeout)
+    {
+        m_timeout = timeout;
+    }
+
+    // Queues up a write to be sent in the background. Returns immediately.
+    //  pTransfer is the client owned transfer object used to track this write. Its getStatus() method can be used to
+    //            determine when the write has completed. A latest wins write staged while the previous one is on the
+    //            bus is dropped if that previous write fails and getStatus() reports the failure instead.
+    //  address is the 8-bit I2C address of the device (same format as used by the mbed I2C::write() method).
+    //  pData points to the bytes to be written. They are copied so the buffer can be reused as soon as this method
+    //        returns.
+    //  length is the number of bytes to be written. Can't be larger than I2C_ASYNC_MAX_WRITE_SIZE.
+    //  Returns true if the write was queued and false if it was rejected because the transfer isn't latest wins and
+    //  its previous write hasn't completed yet.
+    bool queueWrite(I2CTransfer* pTransfer, int address, const void* pData, size_t length);
+
+    // Returns true if there are no writes queued or in progress.
+    bool isIdle()
+    {
+        return m_pActive == NULL && m_pHead == NULL;
+    }
+
+    // Blocks until all queued writes have been sent or have timed out.
+    void flush();
+
+    // Checks to see if the active write has been on the bus longer than the timeout allows. If it has then it is
+    // failed with I2C_TRANSFER_TIMEOUT, the bus is recovered, and the next queued write is started. This is called
+    // from queueWrite() and flush() but can also be called periodically from the main loop so that a stuck bus is
+    // recovered even when no new writes are being queued.
+    void checkTimeout();
+
+protected:
+    void            recoverBus();
+    void            disableInterrupt();
+    void            enableInterrupt();
+    void            appendToQueue(I2CTransfer* pTransfer);
+    void            startNextTransfer(uint32_t conset);
+    void            completeActiveTransfer(I2CTransferStatus status);
+    static void     __i2c0InterruptHandler();
+    static void     __i2c1InterruptHandler();
+    static void     __i2c2InterruptHandler();
+    void            interruptHandler();
+
+    static I2CAsync*         s_pInstances[3];
+    LPC_I2C_TypeDef*         m_pI2C;
+    I2CTransfer* volatile    m_pHead;
+    I2CTransfer*             m_pTail;
+    I2CTransfer* volatile    m_pActive;
+    PinName                  m_sda;
+    PinName                  m_scl;
+    IRQn_Type                m_irq;
+    uint32_t                 m_controller;
+    uint32_t                 m_byteIndex;
+    uint32_t                 m_timeout;
+    volatile uint32_t        m_activeStartTime;
+    uint8_t                  m_retryCount;
+    uint8_t                  m_retriesLeft;
+};
+
+#endif // I2C_ASYNC_H_
@@ -0,0 +1,102 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <mbed.h>
+#include "InterpolationBenchmark.h"
+
+
+void interpolateWithDivision(RGBData* pRgbDest, const HSVData* pHsvStart, const HSVData* pHsvStop,
+                             int32_t curr, int32_t total)
+{
+    HSVData interpolated;
+
+    interpolated.hue = pHsvStart->hue + ((pHsvStop->hue - pHsvStart->hue) * curr) / total;
+    interpolated.saturation = pHsvStart->saturation + ((pHsvStop->saturation - pHsvStart->saturation) * curr) / total;
+    interpolated.value = pHsvStart->value + ((pHsvStop->value - pHsvStart->value) * curr) / total;
+    AnimationBase::interpolateHsvToRgbByFraction(pRgbDest, &interpolated, &interpolated, 0);
+}
+
+void runInterpolationBenchmark(int pixelCount)
+{
+    static const int32_t totalTime = 1000;
+    HSVData*             pHsvStart = new HSVData[pixelCount];
+    HSVData*             pHsvStop = new HSVData[pixelCount];
+    RGBData*             pRgb = new RGBData[pixelCount];
+    Timer                benchmarkTimer;
+
+    for (int i = 0 ; i < pixelCount ; i++)
+    {
+        pHsvStart[i].hue = rand();
+        pHsvStart[i].saturation = rand();
+        pHsvStart[i].value = rand();
+        pHsvStop[i].hue = rand();
+        pHsvStop[i].saturation = rand();
+        pHsvStop[i].value = rand();
+    }
+
+    // Interpolate every pixel the old way, with 3 divisions per pixel.
+    benchmarkTimer.start();
+    for (int32_t curr = 0 ; curr <= totalTime ; curr++)
+    {
+        for (int i = 0 ; i < pixelCount ; i++)
+        {
+            interpolateWithDivision(&pRgb[i], &pHsvStart[i], &pHsvStop[i], curr, totalTime);
+        }
+    }
+    int divideTime = benchmarkTimer.read_us();
+
+    // Now interpolate them with one division per time step.
+    benchmarkTimer.reset();
+    for (int32_t curr = 0 ; curr <= totalTime ; curr++)
+    {
+        uint32_t fraction = AnimationBase::calculateInterpolationFraction(curr, totalTime);
+        for (int i = 0 ; i < pixelCount ; i++)
+        {
+            AnimationBase::interpolateHsvToRgbByFraction(&pRgb[i], &pHsvStart[i], &pHsvStop[i], fraction);
+        }
+    }
+    int fractionTime = benchmarkTimer.read_us();
+
+    // Find the largest difference between the two in any of the RGB components. A 1 LSB difference in the
+    // interpolated brightness can become a bit more than that once it has been through the brightness curve.
+    int maxDiff = 0;
+    for (int32_t curr = 0 ; curr <= totalTime ; curr++)
+    {
+        uint32_t fraction = AnimationBase::calculateInterpolationFraction(curr, totalTime);
+        for (int i = 0 ; i < pixelCount ; i++)
+        {
+            RGBData divided;
+            RGBData multiplied;
+            interpolateWithDivision(&divided, &pHsvStart[i], &pHsvStop[i], curr, totalTime);
+            AnimationBase::interpolateHsvToRgbByFraction(&multiplied, &pHsvStart[i], &pHsvStop[i], fraction);
+
+            int redDiff = abs(divided.red - multiplied.red);
+            int greenDiff = abs(divided.green - multiplied.green);
+            int blueDiff = abs(divided.blue - multiplied.blue);
+            if (redDiff > maxDiff)
+                maxDiff = redDiff;
+            if (greenDiff > maxDiff)
+                maxDiff = greenDiff;
+            if (blueDiff > maxDiff)
+                maxDiff = blueDiff;
+        }
+    }
+
+    printf("interpolation of %d pixels x %ld steps: divide %d us    fraction %d us    max RGB diff %d\n",
+           pixelCount, totalTime + 1, divideTime, fractionTime, maxDiff);
+
+    delete [] pRgb;
+    delete [] pHsvStop;
+    delete [] pHsvStart;
+}
@@ -0,0 +1,37 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef INTERPOLATION_BENCHMARK_H_
+#define INTERPOLATION_BENCHMARK_H_
+
+#include "Animation.h"
+
+
+// The division based colour interpolation used before AnimationBase::interpolateHsvToRgbByFraction(). Kept so that
+// the two can be compared, both on the target and by the host harness in host/InterpolationBenchmark/. The brightness
+// curve and RGB conversion are still applied by interpolating from the result to itself.
+//  pRgbDest is filled in with the interpolated colour.
+//  pHsvStart and pHsvStop are the colours at the start and end of the interpolation.
+//  curr is how far into the interpolation we are (0 - total).
+//  total is the length of the whole interpolation. Must be greater than 0.
+void interpolateWithDivision(RGBData* pRgbDest, const HSVData* pHsvStart, const HSVData* pHsvStop,
+                             int32_t curr, int32_t total);
+
+// Times interpolateWithDivision() against the division free AnimationBase::interpolateHsvToRgbByFraction() for
+// interpolating a strip of random colours over 1001 time steps and dumps the results to the serial port, along with
+// the largest difference seen in any RGB component.
+//  pixelCount is the number of pixels to be interpolated at each time step.
+void runInterpolationBenchmark(int pixelCount);
+
+#endif // INTERPOLATION_BENCHMARK_H_
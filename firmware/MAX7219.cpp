@@ -0,0 +1,296 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <assert.h>
+#include <mbed.h>
+#include "GPDMA.h"
+#include "MAX7219.h"
+
+
+// This class utilizes DMA based SPI hardware to send data to the MAX7219 devices.
+// It was only coded to work on the LPC1768.
+#ifndef TARGET_LPC176X
+    #error("This MAX7219Chain class was only coded to work on the LPC1768.")
+#endif
+
+
+// MAX7219 registers.
+#define MAX7219_REG_NOOP            0x00
+#define MAX7219_REG_DIGIT0          0x01
+#define MAX7219_REG_DECODE_MODE     0x09
+#define MAX7219_REG_INTENSITY       0x0A
+#define MAX7219_REG_SCAN_LIMIT      0x0B
+#define MAX7219_REG_SHUTDOWN        0x0C
+#define MAX7219_REG_DISPLAY_TEST    0x0F
+
+// The most register packets that can be sent in a single flush: one for each of the 8 rows and one for intensity.
+#define MAX7219_MAX_PACKETS_PER_FRAME   9
+
+// SSP status and DMA control register bits.
+#define SSP_SR_RNE          (1 << 2)
+#define SSP_DMACR_RXDMAE    (1 << 0)
+#define SSP_DMACR_TXDMAE    (1 << 1)
+
+
+
+MAX7219Chain::MAX7219Chain(PinName mosi, PinName sclk, PinName load, uint32_t deviceCount) :
+    SPI(mosi, NC, sclk),
+    m_load(load, 1)
+{
+    assert ( deviceCount > 0 && deviceCount <= MAX7219_MAX_DEVICES );
+
+    // The MAX7219 takes 16-bit words (register address in the upper byte) and can be clocked at up to 10MHz.
+    format(16, 0);
+    frequency(5000000);
+
+    m_deviceCount = deviceCount;
+    m_framePacketCount = 0;
+    m_packetIndex = 0;
+    m_packetCount = 0;
+    m_isBusy = false;
+    m_isFlushPending = false;
+    m_isStarted = false;
+    memset(m_rows, 0, sizeof(m_rows));
+    memset(m_sentRows, 0, sizeof(m_sentRows));
+    memset(m_intensities, 0, sizeof(m_intensities));
+    memset(m_sentIntensities, 0, sizeof(m_sentIntensities));
+
+    // Place the packet buffer used by the DMA code in a separate RAM bank to optimize performance. The DMA transfers
+    // are 16-bits wide so it must be halfword aligned.
+    uint32_t packetBytes = MAX7219_MAX_PACKETS_PER_FRAME * deviceCount * sizeof(uint16_t);
+    uint32_t packetAddress = (uint32_t)dmaHeap1Alloc(packetBytes + 1);
+    m_pPackets = (uint16_t*)((packetAddress + 1) & ~1);
+
+    // Setup GPDMA module.
+    enableGpdmaPower();
+    enableGpdmaInLittleEndianMode();
+
+    // Add this DMA handler to the linked list of DMA handlers.
+    m_dmaHandler.handler = __spiReceiveInterruptHandler;
+    m_dmaHandler.pContext = (void*)this;
+    addDmaInterruptHandler(&m_dmaHandler);
+}
+
+MAX7219Chain::~MAX7219Chain()
+{
+    if (m_isStarted)
+    {
+        while (m_isBusy)
+        {
+            __NOP();
+        }
+        freeDmaChannel(m_channelTx);
+        freeDmaChannel(m_channelRx);
+    }
+    removeDmaInterruptHandler(&m_dmaHandler);
+}
+
+void MAX7219Chain::begin()
+{
+    if (m_isStarted)
+    {
+        return;
+    }
+
+    // Configure the devices for an 8x8 matrix and clear them. This is only done once so just send it the slow way.
+    writeAll(MAX7219_REG_DISPLAY_TEST, 0);
+    writeAll(MAX7219_REG_SCAN_LIMIT, 7);
+    writeAll(MAX7219_REG_DECODE_MODE, 0);
+    for (int row = 0 ; row < 8 ; row++)
+    {
+        writeAll(MAX7219_REG_DIGIT0 + row, 0);
+    }
+    writeAll(MAX7219_REG_INTENSITY, 0);
+    writeAll(MAX7219_REG_SHUTDOWN, 1);
+
+    // Allocate DMA channels for transmitting and receiving. The receive channel is only used to know when the last
+    // word has been completely shifted out of the SSP so that it is safe to latch the data with LOAD.
+    m_channelTx = allocateDmaChannel(GPDMA_CHANNEL_LOW);
+    m_pChannelTx = dmaChannelFromIndex(m_channelTx);
+    m_channelRx = allocateDmaChannel(GPDMA_CHANNEL_LOW);
+    m_pChannelRx = dmaChannelFromIndex(m_channelRx);
+    bool isSsp1 = _spi.spi == (LPC_SSP_TypeDef*)SPI_1;
+    m_sspTx = isSsp1 ? DMA_PERIPHERAL_SSP1_TX : DMA_PERIPHERAL_SSP0_TX;
+    m_sspRx = isSsp1 ? DMA_PERIPHERAL_SSP1_RX : DMA_PERIPHERAL_SSP0_RX;
+
+    // Turn on DMA transmit and receive requests in SSP.
+    _spi.spi->DMACR = SSP_DMACR_RXDMAE | SSP_DMACR_TXDMAE;
+
+    m_isStarted = true;
+}
+
+void MAX7219Chain::writeAll(uint8_t reg, uint8_t data)
+{
+    m_load = 0;
+    for (uint32_t i = 0 ; i < m_deviceCount ; i++)
+    {
+        write((reg << 8) | data);
+    }
+    m_load = 1;
+}
+
+void MAX7219Chain::flush()
+{
+    if (!m_isStarted)
+    {
+        return;
+    }
+
+    NVIC_DisableIRQ(DMA_IRQn);
+    if (m_isBusy)
+    {
+        // The interrupt handler will start this flush once the current one has been sent.
+        m_isFlushPending = true;
+    }
+    else
+    {
+        startFrame();
+    }
+    NVIC_EnableIRQ(DMA_IRQn);
+}
+
+void MAX7219Chain::startFrame()
+{
+    // Must be called with the DMA interrupt disabled or from within the interrupt handler itself.
+    m_framePacketCount = 0;
+    for (int row = 0 ; row < 8 ; row++)
+    {
+        appendPacket(MAX7219_REG_DIGIT0 + row, &m_rows[0][row], &m_sentRows[0][row], sizeof(m_rows[0]));
+    }
+    appendPacket(MAX7219_REG_INTENSITY, m_intensities, m_sentIntensities, 1);
+
+    if (m_framePacketCount == 0)
+    {
+        // Nothing has changed so there is nothing to send.
+        m_isBusy = false;
+        return;
+    }
+    m_isBusy = true;
+    m_packetIndex = 0;
+    startPacket();
+}
+
+void MAX7219Chain::appendPacket(uint8_t reg, const uint8_t* pNew, uint8_t* pSent, uint32_t stride)
+{
+    uint16_t* pPacket = m_pPackets + m_framePacketCount * m_deviceCount;
+    bool      isChanged = false;
+
+    for (uint32_t device = 0 ; device < m_deviceCount ; device++)
+    {
+        // The first word shifted out ends up in the last device of the chain.
+        uint16_t* pWord = &pPacket[m_deviceCount - 1 - device];
+        uint8_t   value = pNew[device * stride];
+
+        if (value != pSent[device * stride])
+        {
+            pSent[device * stride] = value;
+            *pWord = (reg << 8) | value;
+            isChanged = true;
+        }
+        else
+        {
+            // Leave the devices which haven't changed alone.
+            *pWord = MAX7219_REG_NOOP << 8;
+        }
+    }
+
+    // Only keep the packet if at least one device in the chain needs the register update.
+    if (isChanged)
+    {
+        m_framePacketCount++;
+    }
+}
+
+void MAX7219Chain::startPacket()
+{
+    LPC_SSP_TypeDef* pSsp = _spi.spi;
+    uint16_t*        pPacket = m_pPackets + m_packetIndex * m_deviceCount;
+    uint32_t         channelMask = (1 << m_channelTx) | (1 << m_channelRx);
+    uint32_t         control = (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_SBSIZE_SHIFT) |
+                               (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_DBSIZE_SHIFT) |
+                               (DMACCxCONTROL_WIDTH_HALFWORD << DMACCxCONTROL_SWIDTH_SHIFT) |
+                               (DMACCxCONTROL_WIDTH_HALFWORD << DMACCxCONTROL_DWIDTH_SHIFT) |
+                               (m_deviceCount & DMACCxCONTROL_TRANSFER_SIZE_MASK);
+
+    // Throw away anything left in the receive FIFO so that the receive channel only completes once all of the words
+    // for this packet have been shifted out.
+    while (pSsp->SR & SSP_SR_RNE)
+    {
+        m_dummyRead = pSsp->DR;
+    }
+    LPC_GPDMA->DMACIntTCClear = channelMask;
+    LPC_GPDMA->DMACIntErrClr  = channelMask;
+
+    m_load = 0;
+
+    // Receive channel interrupts once the last word has been received.
+    m_pChannelRx->DMACCSrcAddr  = (uint32_t)&pSsp->DR;
+    m_pChannelRx->DMACCDestAddr = (uint32_t)&m_dummyRead;
+    m_pChannelRx->DMACCLLI      = 0;
+    m_pChannelRx->DMACCControl  = DMACCxCONTROL_I | control;
+    m_pChannelRx->DMACCConfig   = DMACCxCONFIG_ENABLE |
+                                  (m_sspRx << DMACCxCONFIG_SRC_PERIPHERAL_SHIFT) |
+                                  DMACCxCONFIG_TRANSFER_TYPE_P2M |
+                                  DMACCxCONFIG_IE |
+                                  DMACCxCONFIG_ITC;
+
+    // Transmit channel feeds the packet into the SSP.
+    m_pChannelTx->DMACCSrcAddr  = (uint32_t)pPacket;
+    m_pChannelTx->DMACCDestAddr = (uint32_t)&pSsp->DR;
+    m_pChannelTx->DMACCLLI      = 0;
+    m_pChannelTx->DMACCControl  = DMACCxCONTROL_SI | control;
+    m_pChannelTx->DMACCConfig   = DMACCxCONFIG_ENABLE |
+                                  (m_sspTx << DMACCxCONFIG_DEST_PERIPHERAL_SHIFT) |
+                                  DMACCxCONFIG_TRANSFER_TYPE_M2P;
+}
+
+uint32_t MAX7219Chain::__spiReceiveInterruptHandler(void* pContext, uint32_t dmaInterruptStatus)
+{
+    MAX7219Chain* pThis = (MAX7219Chain*)pContext;
+
+    return pThis->spiReceiveInterruptHandler(dmaInterruptStatus);
+}
+
+uint32_t MAX7219Chain::spiReceiveInterruptHandler(uint32_t dmaInterruptStatus)
+{
+    uint32_t rxChannelMask = 1 << m_channelRx;
+
+    if (!m_isStarted || (dmaInterruptStatus & rxChannelMask) == 0)
+    {
+        return 0;
+    }
+    LPC_GPDMA->DMACIntTCClear = rxChannelMask;
+
+    // Every word of the packet has been shifted out so latch them into the devices.
+    m_load = 1;
+    m_packetCount++;
+
+    m_packetIndex++;
+    if (m_packetIndex < m_framePacketCount)
+    {
+        startPacket();
+    }
+    else if (m_isFlushPending)
+    {
+        m_isFlushPending = false;
+        startFrame();
+    }
+    else
+    {
+        m_isBusy = false;
+    }
+
+    // Flag that we have handled this interrupt.
+    return rxChannelMask;
+}
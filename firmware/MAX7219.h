@@ -0,0 +1,161 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef MAX7219_H_
+#define MAX7219_H_
+
+#include <assert.h>
+#include <mbed.h>
+#include "EyeDisplay.h"
+#include "GPDMA.h"
+
+
+// The most MAX7219 devices which can be daisy chained together on one MAX7219Chain object.
+#define MAX7219_MAX_DEVICES     8
+
+
+// Drives a daisy chain of MAX7219 8x8 LED matrix modules (like the ones used with the Arduino LedControl library).
+// Register writes are sent through the SSP hardware using GPDMA so the CPU doesn't need to wait for the bits to be
+// shifted out. Only the rows which have changed since the last flush() are sent. For each changed row, one 16-bit word
+// is shifted out per device in the chain, with No-Op words for the devices whose row hasn't changed.
+// It was only coded to work on the LPC1768.
+class MAX7219Chain : public SPI
+{
+public:
+    // Constructor
+    //  mosi is the SSP MOSI pin connected to DIN of the first device in the chain.
+    //  sclk is the SSP SCLK pin connected to CLK of all the devices.
+    //  load is the pin connected to LOAD/CS of all the devices. Can be any GPIO pin.
+    //  deviceCount is the number of devices in the chain (1 - MAX7219_MAX_DEVICES).
+    MAX7219Chain(PinName mosi, PinName sclk, PinName load, uint32_t deviceCount);
+    ~MAX7219Chain();
+
+    // Should be first call to the chain. Initializes all of the devices for use with an 8x8 matrix, clears them, and
+    // sets them to their lowest intensity. Blocks until the initialization has been sent.
+    void begin();
+
+    // Sets the 8 LEDs in a row of one device. Still need a subsequent call to flush() to send it to the device.
+    //  device is the index of the device in the chain. 0 is the device connected directly to the LPC1768.
+    //  row is the row to be updated (0 - 7).
+    //  rowData is the state of each LED in the row. The msb is column 0 as with LedControl::setRow().
+    void setRow(uint32_t device, int row, uint8_t rowData)
+    {
+        assert ( device < m_deviceCount && row >= 0 && row < 8 );
+        m_rows[device][row] = rowData;
+    }
+
+    // Sets the intensity of one device. Still need a subsequent call to flush() to send it to the device.
+    //  device is the index of the device in the chain.
+    //  intensity is the brightness of the device's LEDs (0 - 15).
+    void setIntensity(uint32_t device, uint8_t intensity)
+    {
+        assert ( device < m_deviceCount );
+        m_intensities[device] = intensity > 15 ? 15 : intensity;
+    }
+
+    // Starts sending the rows and intensities which have changed since the last flush(). Returns immediately and the
+    // data is sent in the background. If a previous flush() is still being sent then this one will be sent once it
+    // completes.
+    void flush();
+
+    // Returns true if there is no flush() currently being sent.
+    bool isIdle()
+    {
+        return !m_isBusy;
+    }
+
+    // Number of register packets (one register write for every device in the chain) sent since construction.
+    uint32_t getPacketCount()
+    {
+        return m_packetCount;
+    }
+
+protected:
+    void            writeAll(uint8_t reg, uint8_t data);
+    void            startFrame();
+    void            startPacket();
+    void            appendPacket(uint8_t reg, const uint8_t* pNew, uint8_t* pSent, uint32_t stride);
+    static uint32_t __spiReceiveInterruptHandler(void* pContext, uint32_t dmaInterruptStatus);
+    uint32_t        spiReceiveInterruptHandler(uint32_t dmaInterruptStatus);
+
+    DigitalOut              m_load;
+    DmaInterruptHandler     m_dmaHandler;
+    LPC_GPDMACH_TypeDef*    m_pChannelTx;
+    LPC_GPDMACH_TypeDef*    m_pChannelRx;
+    uint16_t*               m_pPackets;
+    uint32_t                m_channelTx;
+    uint32_t                m_channelRx;
+    uint32_t                m_sspTx;
+    uint32_t                m_sspRx;
+    uint32_t                m_deviceCount;
+    uint32_t                m_framePacketCount;
+    uint32_t                m_packetIndex;
+    uint32_t                m_packetCount;
+    volatile bool           m_isBusy;
+    volatile bool           m_isFlushPending;
+    bool                    m_isStarted;
+    uint16_t                m_dummyRead;
+    uint8_t                 m_rows[MAX7219_MAX_DEVICES][8];
+    uint8_t                 m_sentRows[MAX7219_MAX_DEVICES][8];
+    uint8_t                 m_intensities[MAX7219_MAX_DEVICES];
+    uint8_t                 m_sentIntensities[MAX7219_MAX_DEVICES];
+};
+
+
+// Eye displayed on one MAX7219 8x8 matrix module in a MAX7219Chain.
+class MAX7219EyeDisplay : public IEyeDisplay
+{
+public:
+    MAX7219EyeDisplay()
+    {
+        m_pChain = NULL;
+        m_device = 0;
+    }
+
+    // Attaches this eye to a device in the chain. The chain's begin() method should have already been called.
+    //  pChain is a pointer to the chain containing the device used for this eye.
+    //  device is the index of the device in the chain.
+    void begin(MAX7219Chain* pChain, uint32_t device)
+    {
+        m_pChain = pChain;
+        m_device = device;
+    }
+
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t bitboard)
+    {
+        // The MAX7219 modules have column 0 in the msb of each row so flip the bitboard to match.
+        bitboard = bitboardMirrorHorizontal(bitboard);
+        for (int row = 0 ; row < 8 ; row++)
+        {
+            m_pChain->setRow(m_device, row, bitboardRow(bitboard, row));
+        }
+    }
+    virtual void setBrightness(uint8_t brightness)
+    {
+        m_pChain->setIntensity(m_device, brightness);
+    }
+    virtual void flush()
+    {
+        // Flushing the chain sends the changes for every eye on it so the extra flushes for the other eyes in the same
+        // frame find nothing left to send.
+        m_pChain->flush();
+    }
+
+protected:
+    MAX7219Chain* m_pChain;
+    uint32_t      m_device;
+};
+
+#endif // MAX7219_H_
@@ -25,6 +25,13 @@
 #endif
 
 
+// Each NeoPixel data-bit is sent as 12 SPI bits so each 24-bit LED takes 36 bytes.
+#define BYTES_PER_LED               36
+// The most bytes sent by each DMA linked list item. The 12-bit transfer size field can hold up to 4095 but keep it a
+// multiple of the 4 byte burst size.
+#define MAX_BYTES_PER_DMA_ITEM      4092
+
+
 
 NeoPixel::NeoPixel(uint32_t ledCount, PinName outputPin) : SPI(outputPin, NC, NC)
 {
@@ -38,7 +45,10 @@ NeoPixel::NeoPixel(uint32_t ledCount, PinName outputPin) : SPI(outputPin, NC, NC
     frequency(10000000);
 
     m_flipCount = 0;
+    m_setCount = 0;
     m_isStarted = false;
+    m_isComposing = false;
+    m_isFrameDirty = false;
     m_ledCount = ledCount;
     m_backBufferState = BackBufferFree;
     m_backBufferId = 0;
@@ -50,7 +60,13 @@ NeoPixel::NeoPixel(uint32_t ledCount, PinName outputPin) : SPI(outputPin, NC, NC
     // The byte count dedicated to LED output data should be an even multiple of 3 bytes.
     assert ( (ledBits % 8) == 0 );
     m_ledBytes = ledBits / 8;
-    m_packetSize = m_ledBytes + (resetBits + 7) / 8;
+    assert ( m_ledBytes == ledCount * BYTES_PER_LED );
+    // Round the packet up to a multiple of 4 bytes (longer reset) so that the DMA mem copies can be done a word at a
+    // time.
+    m_packetSize = (m_ledBytes + (resetBits + 7) / 8 + 3) & ~3;
+    assert ( m_packetSize <= NEOPIXEL_MAX_DMA_ITEMS_PER_BUFFER * MAX_BYTES_PER_DMA_ITEM );
+    m_windowStart = 0;
+    m_windowCount = ledCount;
 
     // Place buffers used by DMA code in separate RAM bank to optimize performance.
     m_pFrontBuffers[0] = (uint8_t*)dmaHeap0Alloc(m_packetSize);
@@ -132,26 +148,13 @@ void NeoPixel::start()
     LPC_GPDMA->DMACIntErrClr  = channelMask;
 
     // Prepare transmit channel DMA circular linked list to use 2 front buffers.
-    m_dmaListItems[0].DMACCxSrcAddr  = (uint32_t)m_pFrontBuffers[0];
-    m_dmaListItems[0].DMACCxDestAddr = (uint32_t)&_spi.spi->DR;
-    m_dmaListItems[0].DMACCxLLI      = (uint32_t)&m_dmaListItems[1];
-    m_dmaListItems[0].DMACCxControl  = DMACCxCONTROL_I | DMACCxCONTROL_SI |
-                     (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_SBSIZE_SHIFT) |
-                     (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_DBSIZE_SHIFT) |
-                     (m_packetSize & DMACCxCONTROL_TRANSFER_SIZE_MASK);
-
-    m_dmaListItems[1].DMACCxSrcAddr  = (uint32_t)m_pFrontBuffers[1];
-    m_dmaListItems[1].DMACCxDestAddr = (uint32_t)&_spi.spi->DR;
-    m_dmaListItems[1].DMACCxLLI      = (uint32_t)&m_dmaListItems[0];
-    m_dmaListItems[1].DMACCxControl  = DMACCxCONTROL_I | DMACCxCONTROL_SI |
-                     (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_SBSIZE_SHIFT) |
-                     (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_DBSIZE_SHIFT) |
-                     (m_packetSize & DMACCxCONTROL_TRANSFER_SIZE_MASK);
-
-    m_pChannelTx->DMACCSrcAddr  = m_dmaListItems[0].DMACCxSrcAddr;
-    m_pChannelTx->DMACCDestAddr = m_dmaListItems[0].DMACCxDestAddr;
-    m_pChannelTx->DMACCLLI      = m_dmaListItems[0].DMACCxLLI;
-    m_pChannelTx->DMACCControl  = m_dmaListItems[0].DMACCxControl;
+    initDmaListItems(m_dmaListItems[0], m_pFrontBuffers[0], m_dmaListItems[1]);
+    initDmaListItems(m_dmaListItems[1], m_pFrontBuffers[1], m_dmaListItems[0]);
+
+    m_pChannelTx->DMACCSrcAddr  = m_dmaListItems[0][0].DMACCxSrcAddr;
+    m_pChannelTx->DMACCDestAddr = m_dmaListItems[0][0].DMACCxDestAddr;
+    m_pChannelTx->DMACCLLI      = m_dmaListItems[0][0].DMACCxLLI;
+    m_pChannelTx->DMACCControl  = m_dmaListItems[0][0].DMACCxControl;
 
     // Enable transmit channel.
     m_pChannelTx->DMACCConfig = DMACCxCONFIG_ENABLE |
@@ -166,15 +169,53 @@ void NeoPixel::start()
     m_isStarted = true;
 }
 
+void NeoPixel::initDmaListItems(DmaLinkedListItem* pItems, uint8_t* pBuffer, DmaLinkedListItem* pNextBufferItems)
+{
+    // Split the buffer across as many linked list items as needed to get around the 4095 transfer size limit. Only
+    // the last item of each buffer interrupts so that the handler still runs once per buffer flip.
+    uint32_t bytesLeft = m_packetSize;
+    while (bytesLeft > 0)
+    {
+        uint32_t bytes = (bytesLeft > MAX_BYTES_PER_DMA_ITEM) ? MAX_BYTES_PER_DMA_ITEM : bytesLeft;
+        bool     isLast = bytes == bytesLeft;
+
+        pItems->DMACCxSrcAddr  = (uint32_t)pBuffer;
+        pItems->DMACCxDestAddr = (uint32_t)&_spi.spi->DR;
+        pItems->DMACCxLLI      = isLast ? (uint32_t)pNextBufferItems : (uint32_t)(pItems + 1);
+        pItems->DMACCxControl  = (isLast ? DMACCxCONTROL_I : 0) | DMACCxCONTROL_SI |
+                         (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_SBSIZE_SHIFT) |
+                         (DMACCxCONTROL_BURSTSIZE_4 << DMACCxCONTROL_DBSIZE_SHIFT) |
+                         (bytes & DMACCxCONTROL_TRANSFER_SIZE_MASK);
+
+        pBuffer += bytes;
+        bytesLeft -= bytes;
+        pItems++;
+    }
+}
+
 void NeoPixel::set(const RGBData* pPixels, size_t pixelCount)
 {
-    assert ( pixelCount == m_ledCount );
+    if (!m_isComposing)
+    {
+        // Not composing a frame out of windows so just send this one set of pixels for the whole strip.
+        beginFrame();
+        set(pPixels, pixelCount);
+        endFrame();
+        return;
+    }
+
+    assert ( pixelCount == m_windowCount );
 
-    waitForFreeBackBuffer();
+    // The back buffer still holds the last frame so only the LEDs in this window need to be encoded.
+    if (!m_isFrameDirty)
+    {
+        waitForFreeBackBuffer();
+        m_isFrameDirty = true;
+    }
 
     // Emit bits into the now free back buffer.
-    m_pEmitBuffer = m_pBackBuffer;
-    for (uint32_t i = 0 ; i < m_ledCount ; i++)
+    m_pEmitBuffer = m_pBackBuffer + m_windowStart * BYTES_PER_LED;
+    for (uint32_t i = 0 ; i < m_windowCount ; i++)
     {
         RGBData led = *pPixels++;
 
@@ -182,6 +223,34 @@ void NeoPixel::set(const RGBData* pPixels, size_t pixelCount)
         emitByte(led.red);
         emitByte(led.blue);
     }
+}
+
+void NeoPixel::beginFrame()
+{
+    assert ( !m_isComposing );
+    m_isComposing = true;
+    m_isFrameDirty = false;
+    setWindow(0, m_ledCount);
+}
+
+void NeoPixel::setWindow(uint32_t firstLed, uint32_t ledCount)
+{
+    assert ( m_isComposing );
+    assert ( firstLed + ledCount <= m_ledCount );
+    m_windowStart = firstLed;
+    m_windowCount = ledCount;
+}
+
+void NeoPixel::endFrame()
+{
+    assert ( m_isComposing );
+    m_isComposing = false;
+    if (!m_isFrameDirty)
+    {
+        // Nothing in the frame changed so there is no need to send it again.
+        return;
+    }
+    m_isFrameDirty = false;
 
     // Let the DMA interrupt handler know that the back buffer is now ready to be copied into the next free
     // front buffer.
@@ -20,6 +20,11 @@
 #include "GPDMA.h"
 
 
+// The most DMA linked list items used to send each of the two front buffers. Each item can send up to 4092 bytes
+// (113 LEDs) so this allows strips of more than 400 LEDs.
+#define NEOPIXEL_MAX_DMA_ITEMS_PER_BUFFER   4
+
+
 class NeoPixel : public SPI
 {
 public:
@@ -29,7 +34,20 @@ public:
     void     start();
     void     set(const RGBData* pPixels, size_t pixelCount);
 
-    // Number of times set() method was called.
+    // Starts composing a frame out of several windows of the strip (ie. a candle ring and a couple of 8x8 eye
+    // panels). Within a frame, each set() call only encodes the LEDs in the current window and leaves the rest of the
+    // strip as it was in the previous frame. The composed frame is handed to the DMA hardware once by endFrame().
+    // Outside of a frame, set() updates the whole strip and sends it right away, as before.
+    void     beginFrame();
+    // Selects the range of LEDs to be updated by the following set() calls in the current frame. beginFrame() starts
+    // out with the window covering the whole strip.
+    //  firstLed is the index of the first LED in the window.
+    //  ledCount is the number of LEDs in the window. It must match the pixelCount passed into set().
+    void     setWindow(uint32_t firstLed, uint32_t ledCount);
+    // Sends the frame composed since beginFrame() if any of its windows were set.
+    void     endFrame();
+
+    // Number of frames handed to the DMA hardware, either by set() or endFrame().
     uint32_t getSetCount()
     {
         return m_setCount;
@@ -45,6 +63,7 @@ protected:
     void setConstantBitsInBuffer(uint8_t* pBuffer);
     void waitForFreeBackBuffer();
     void emitByte(uint8_t byte);
+    void initDmaListItems(DmaLinkedListItem* pItems, uint8_t* pBuffer, DmaLinkedListItem* pNextBufferItems);
 
     static uint32_t __spiTransmitInterruptHandler(void* pContext, uint32_t dmaInterruptStatus);
     uint32_t        spiTransmitInterruptHandler(uint32_t dmaInterruptStatus);
@@ -64,18 +83,22 @@ protected:
     LPC_GPDMACH_TypeDef*        m_pChannelTx;
     DmaInterruptHandler         m_dmaHandler;
     DmaMemCopyCallback          m_dmaMemCopyCallback;
-    DmaLinkedListItem           m_dmaListItems[2];
+    DmaLinkedListItem           m_dmaListItems[2][NEOPIXEL_MAX_DMA_ITEMS_PER_BUFFER];
     uint32_t                    m_channelTx;
     uint32_t                    m_sspTx;
     uint32_t                    m_ledCount;
     uint32_t                    m_ledBytes;
     uint32_t                    m_packetSize;
     uint32_t                    m_setCount;
+    uint32_t                    m_windowStart;
+    uint32_t                    m_windowCount;
     volatile uint32_t           m_flipCount;
     volatile uint32_t           m_backBufferId;
     volatile uint32_t           m_frontBufferIds[2];
     volatile BackBufferState    m_backBufferState;
     bool                        m_isStarted;
+    bool                        m_isComposing;
+    bool                        m_isFrameDirty;
     uint8_t                     m_dummyRead;
 };
 
@@ -0,0 +1,155 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <assert.h>
+#include "Bitboard.h"
+#include "NeoPixelEyeDisplay.h"
+
+
+NeoPixelEyeDisplay::NeoPixelEyeDisplay()
+{
+    m_pColours = NULL;
+    m_eyeBall = 0;
+    m_frame = 0;
+    m_renderedFrame = 0;
+    m_lidMask = 0;
+    m_renderedLidMask = 0;
+    m_renderCount = 0;
+    m_brightness = 0;
+    m_renderedBrightness = 0;
+    m_isRendered = false;
+    m_isPixelsDirty = false;
+}
+
+void NeoPixelEyeDisplay::begin(const NeoPixelEyeColours* pColours, uint64_t eyeBall)
+{
+    m_pColours = pColours;
+    m_eyeBall = eyeBall;
+    m_isRendered = false;
+}
+
+void NeoPixelEyeDisplay::setFrame(uint64_t bitboard)
+{
+    m_frame = bitboard;
+}
+
+void NeoPixelEyeDisplay::setLidMask(uint64_t lids)
+{
+    m_lidMask = lids;
+}
+
+void NeoPixelEyeDisplay::setBrightness(uint8_t brightness)
+{
+    m_brightness = brightness > 15 ? 15 : brightness;
+}
+
+void NeoPixelEyeDisplay::flush()
+{
+    // Only need to render the colour image again if the frame, lids or brightness have changed since last time.
+    if (m_isRendered && m_frame == m_renderedFrame && m_lidMask == m_renderedLidMask &&
+        m_brightness == m_renderedBrightness)
+        return;
+    render();
+}
+
+void NeoPixelEyeDisplay::render()
+{
+    assert ( m_pColours );
+
+    // The lid mask and rows of the eye ball which are completely dark are covered by the lid. The pupil never covers a
+    // whole row.
+    uint64_t lids = m_lidMask & m_eyeBall;
+    for (int row = 0 ; row < 8 ; row++)
+    {
+        if (bitboardRow(m_eyeBall, row) != 0 && bitboardRow(m_frame, row) == 0)
+            lids |= bitboardRowMask(row);
+    }
+
+    // The rest of the dark pixels in the eye ball form the pupil and the lit pixels touching it form the iris.
+    uint64_t pupil = m_eyeBall & ~m_frame & ~lids;
+    uint64_t ring = pupil | bitboardShiftLeft(pupil, 1) | bitboardShiftRight(pupil, 1);
+    ring |= bitboardShiftUp(ring, 1) | bitboardShiftDown(ring, 1);
+    uint64_t iris = ring & m_frame;
+
+    // Scale all of the colours by the brightness (0 - 15) like the HT16K33 does, where 0 is dim but still on.
+    uint32_t scale = (m_brightness + 1) * 16;
+    RGBData  sclera = scaleColour(&m_pColours->sclera, scale);
+    RGBData  irisColour = scaleColour(&m_pColours->iris, scale);
+    RGBData  pupilColour = scaleColour(&m_pColours->pupil, scale);
+    RGBData  black;
+    uint64_t openRows = m_eyeBall & ~lids;
+
+    RGBData* pPixel = m_pixels;
+    for (int row = 0 ; row < 8 ; row++)
+    {
+        RGBData lidColour;
+        if (lids & bitboardRowMask(row))
+        {
+            // Find how far this row is from the edge of the lid so that the lid can fade out away from its edge. The
+            // edge of a fully closed lid is across the middle of the eye.
+            int distance = 0;
+            if (openRows == 0)
+            {
+                distance = (row < 4) ? 3 - row : row - 4;
+            }
+            else
+            {
+                while (!(row - distance - 1 >= 0 && bitboardRow(openRows, row - distance - 1)) &&
+                       !(row + distance + 1 < 8 && bitboardRow(openRows, row + distance + 1)))
+                {
+                    distance++;
+                }
+            }
+            lidColour = scaleColour(&m_pColours->lid, scale >> distance);
+        }
+
+        for (int column = 0 ; column < 8 ; column++)
+        {
+            uint64_t pixelMask = 1ULL << (row * 8 + column);
+
+            if ((m_eyeBall & pixelMask) == 0)
+                *pPixel = black;
+            else if (lids & pixelMask)
+                *pPixel = lidColour;
+            else if (pupil & pixelMask)
+                *pPixel = pupilColour;
+            else if (iris & pixelMask)
+                *pPixel = irisColour;
+            else
+                *pPixel = sclera;
+            pPixel++;
+        }
+    }
+
+    m_renderedFrame = m_frame;
+    m_renderedLidMask = m_lidMask;
+    m_renderedBrightness = m_brightness;
+    m_isRendered = true;
+    m_isPixelsDirty = true;
+    m_renderCount++;
+}
+
+RGBData NeoPixelEyeDisplay::scaleColour(const RGBData* pColour, uint32_t scale)
+{
+    return RGBData((pColour->red * scale) >> 8, (pColour->green * scale) >> 8, (pColour->blue * scale) >> 8);
+}
+
+void NeoPixelEyeDisplay::updatePixels(NeoPixel& ledControl)
+{
+    // Only encode this eye into the NeoPixel frame when its colour image has changed.
+    if (!m_isPixelsDirty)
+        return;
+    ledControl.set(m_pixels, NEOPIXEL_EYE_LED_COUNT);
+    m_isPixelsDirty = false;
+}
@@ -0,0 +1,96 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef NEO_PIXEL_EYE_DISPLAY_H_
+#define NEO_PIXEL_EYE_DISPLAY_H_
+
+#include <stdint.h>
+#include "Animation.h"
+#include "EyeDisplay.h"
+#include "NeoPixel.h"
+
+
+// The number of LEDs in each 8x8 NeoPixel eye panel.
+#define NEOPIXEL_EYE_LED_COUNT  64
+
+
+// The colours used to render the different parts of a full colour eye.
+struct NeoPixelEyeColours
+{
+    // The eye ball pixels which aren't next to the pupil.
+    RGBData sclera;
+    // The eye ball pixels which ring the pupil.
+    RGBData iris;
+    // The pixels of the eye ball which are turned off in the monochrome image to form the pupil. Lighting them up in
+    // their own colour gives a glowing pupil.
+    RGBData pupil;
+    // The pixels of the eye ball which are hidden by the eye lids. The row at the edge of the lid gets this colour and
+    // each row further from the edge fades to half the brightness of the one before it.
+    RGBData lid;
+};
+
+
+// Eye displayed on an 8x8 WS2812 (NeoPixel) panel. The panel is expected to be wired in row order, starting at the
+// top left pixel.
+// The monochrome bitboards from EyeMatrices are coloured in by comparing them to the eye ball image: pixels in the lid
+// mask and rows of the eye ball which are completely dark are covered by the lid, the other dark pixels in the eye
+// ball are the pupil and the lit pixels are the sclera and iris. flush() only renders the colour image into memory.
+// It is encoded into the NeoPixel strip along with everything else on it when the main loop calls updatePixels()
+// while composing a frame.
+class NeoPixelEyeDisplay : public IEyeDisplay, public IPixelUpdate
+{
+public:
+    NeoPixelEyeDisplay();
+
+    // Sets the colours to be used for this eye.
+    //  pColours points to the colours to be used. The structure isn't copied so it needs to stay in scope.
+    //  eyeBall is the bitboard image of the whole eye ball without a pupil for the tile of the eye shown on this
+    //          panel (EyeMatrices::getEyeBallFrame().tiles[tile]).
+    void begin(const NeoPixelEyeColours* pColours, uint64_t eyeBall);
+
+    // Returns the number of times that the colour image has been rendered.
+    uint32_t getRenderCount()
+    {
+        return m_renderCount;
+    }
+
+    // IEyeDisplay methods.
+    virtual void setFrame(uint64_t bitboard);
+    virtual void setLidMask(uint64_t lids);
+    virtual void setBrightness(uint8_t brightness);
+    virtual void flush();
+
+    // IPixelUpdate methods.
+    //  ledControl should already have its window set to the NEOPIXEL_EYE_LED_COUNT LEDs of this eye's panel.
+    virtual void updatePixels(NeoPixel& ledControl);
+
+protected:
+    void    render();
+    RGBData scaleColour(const RGBData* pColour, uint32_t scale);
+
+    const NeoPixelEyeColours* m_pColours;
+    uint64_t                  m_eyeBall;
+    uint64_t                  m_frame;
+    uint64_t                  m_renderedFrame;
+    uint64_t                  m_lidMask;
+    uint64_t                  m_renderedLidMask;
+    uint32_t                  m_renderCount;
+    uint8_t                   m_brightness;
+    uint8_t                   m_renderedBrightness;
+    bool                      m_isRendered;
+    bool                      m_isPixelsDirty;
+    RGBData                   m_pixels[NEOPIXEL_EYE_LED_COUNT];
+};
+
+#endif // NEO_PIXEL_EYE_DISPLAY_H_
@@ -117,12 +117,14 @@ static inline void rgbToHsv(HSVData* pHSV, const RGBData* pRGB)
     {
         pHSV->hue = 0;
         pHSV->saturation = 0;
+        return;
     }
 
     pHSV->saturation = 255 * (rgbMax - rgbMin) / pHSV->value;
     if (pHSV->saturation == 0)
     {
         pHSV->hue = 0;
+        return;
     }
 
     if (rgbMax == red)
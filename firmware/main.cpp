@@ -16,21 +16,70 @@
 #include "Adafruit_LEDBackpack.h"
 #include "Animation.h"
 #include "EyeAnimations.h"
+#include "GrayscaleEyeDisplay.h"
+#include "I2CAsync.h"
+#include "InterpolationBenchmark.h"
+#include "MAX7219.h"
 #include "NeoPixel.h"
+#include "NeoPixelEyeDisplay.h"
 
 
 // The number of LEDs in the Adafruit ring used for the candle.
 #define LED_COUNT                           16
-// The 7-bit I2C address for the left eye 8x8 matrix.
-#define LEFT_EYE_I2C_ADDRESS                0x70
-// The 7-bit I2C address for the right eye 8x8 matrix.
-#define RIGHT_EYE_I2C_ADDRESS               0x71
+// The 7-bit I2C address for the first (left) eye 8x8 matrix. The rest of the EYE_COUNT eyes use the addresses which
+// follow (0x71 for the right eye, etc). When EYE_SIZE is 16, each eye is instead a pair of 16x8 backpacks, top then
+// bottom, so the left eye uses 0x70 and 0x71, the right eye uses 0x72 and 0x73, etc.
+#define FIRST_EYE_I2C_ADDRESS               0x70
+// The pins used for the I2C bus to which the left eye matrices (even eye indices) are attached.
+#define LEFT_EYE_I2C_SDA                    p9
+#define LEFT_EYE_I2C_SCL                    p10
+// Set to 1 if the right eye matrices (odd eye indices) are attached to their own I2C controller so that the left and
+// right eyes can be updated at the same time. Set to 0 if all of the matrices share the left eye's bus.
+#define EYES_ON_SEPARATE_I2C_BUSES          0
+// The pins used for the right eyes' I2C bus when EYES_ON_SEPARATE_I2C_BUSES is 1. Must be a different controller than
+// the left eyes: p9/p10 (I2C1) or p28/p27 (I2C2).
+#define RIGHT_EYE_I2C_SDA                   p28
+#define RIGHT_EYE_I2C_SCL                   p27
+// The I2C bus frequency used for the eye matrices. The HT16K33 supports 1MHz Fast-mode Plus but I2CAsync will limit
+// this to 400kHz unless the matrices are wired to I2C0 (P0.27/P0.28) since it has the only Fast-mode Plus pads.
+#define EYE_I2C_FREQUENCY                   1000000
+// Set to 1 if the eyes are MAX7219 8x8 modules (as used by the original LedEyes.ino) instead of HT16K33 backpacks. The
+// modules are daisy chained with eye 0 being the module connected directly to the mbed.
+#define USE_MAX7219_EYES                    0
+// The SSP pins used to drive the MAX7219 chain. p5/p7 are the MOSI/SCLK pins for SSP1 since SSP0 (p11) is used for
+// the NeoPixel candle.
+#define MAX7219_MOSI                        p5
+#define MAX7219_SCLK                        p7
+// The GPIO pin connected to the LOAD/CS pin of the MAX7219 chain.
+#define MAX7219_LOAD                        p8
+// Set to 1 if the eyes are full colour 8x8 NeoPixel panels chained onto the end of the candle's LED ring instead of
+// HT16K33 backpacks. The candle and eyes are then composed into a single NeoPixel frame.
+#define USE_NEOPIXEL_EYES                   0
+// The total number of NeoPixel LEDs driven from p11. The DMA buffers for each frame take 36 bytes per LED from a 16k
+// RAM bank so this can't be much more than 400.
+#define NEOPIXEL_LED_COUNT                  (LED_COUNT + (USE_NEOPIXEL_EYES ? EYE_COUNT * EYE_TILE_COUNT * \
+                                                                              NEOPIXEL_EYE_LED_COUNT : 0))
+// Set to 1 to drive the HT16K33 backpacks with the bit plane refresh engine so that each pixel can have its own level
+// of brightness. It keeps the I2C bus busy so it works best with EYES_ON_SEPARATE_I2C_BUSES and Fast-mode Plus.
+#define USE_GRAYSCALE_EYES                  0
+#if USE_MAX7219_EYES + USE_NEOPIXEL_EYES + USE_GRAYSCALE_EYES > 1
+    #error("Only one of USE_MAX7219_EYES, USE_NEOPIXEL_EYES and USE_GRAYSCALE_EYES can be set.")
+#endif
+#if USE_MAX7219_EYES && EYE_COUNT * EYE_TILE_COUNT > MAX7219_MAX_DEVICES
+    #error("Too many 8x8 tiles in the eyes for one MAX7219 chain.")
+#endif
+#if !USE_MAX7219_EYES && !USE_NEOPIXEL_EYES && EYE_SIZE != 8 && (EYE_SIZE != 16 || USE_GRAYSCALE_EYES)
+    #error("HT16K33 eyes only support EYE_SIZE of 8, or 16 without USE_GRAYSCALE_EYES.")
+#endif
 // How many times through the main pumpkin eye animation loop before an eye effect is played? 0 to disable effects.
 #define EFFECT_ITERATION                    4
 // The number of seconds between dumping of animation performance counters to the serial port.
 #define SECONDS_BETWEEN_COUNTER_DUMPS       10
 // The number of milliseconds to delay betweenn initial centering of eyes and initial eye wink.
 #define MILLISECONDS_FOR_INITIAL_DELAY      2000
+// Set to 1 to have the division free colour interpolation timed against the division based interpolation which it
+// replaced at startup. The results are dumped to the serial port.
+#define RUN_INTERPOLATION_BENCHMARK         0
 
 
 enum EyeState
@@ -47,7 +96,6 @@ enum EyeState
     STATE_DELAY_AFTER_BLINK,
     STATE_EFFECT_CHOOSER,
     STATE_EFFECT_RUNNING,
-    STATE_CRAZY_BLINK_STARTED,
     STATE_DELAY_AFTER_EFFECT,
     STATE_DONE
 };
@@ -61,14 +109,50 @@ enum EyeEffects
     EFFECT_LAZY_EYE,
     EFFECT_CRAZY_BLINK,
     EFFECT_GLOW_EYES,
+    EFFECT_DILATE_PUPILS,
+    EFFECT_EXPRESSION,
+    EFFECT_FLASH_EYES,
     EFFECT_MAX
 };
 
+// The EyeAnimationTracks used by the eye animation state machine. The state machine itself runs on TRACK_MAIN and
+// TRACK_BLINK can blink the eyes at the same time.
+enum EyeTracks
+{
+    TRACK_MAIN,
+    TRACK_BLINK
+};
+
+// The animations played on TRACK_MAIN only ever run one at a time so they share a single slot which is just large
+// enough for the biggest of them. The second blink on TRACK_BLINK can run alongside them so it gets its own object.
+typedef EyeAnimationSlot<DelayAnimation,
+                         BlinkAnimation,
+                         MoveEyeAnimation,
+                         CrossEyesAnimation,
+                         RoundSpinAnimation,
+                         CrazySpinAnimation,
+                         MethEyesAnimation,
+                         LazyEyeAnimation,
+                         GlowEyesAnimation,
+                         DilatePupilsAnimation,
+                         ExpressionAnimation,
+                         FlashEyesAnimation> MainAnimationSlot;
+
 static IPixelUpdate*    g_pCandleFlicker;
 
+// The colours used for the eyes when they are NeoPixel panels: orange eye with a red iris and glowing yellow pupil.
+static const NeoPixelEyeColours g_eyeColours =
+{
+    DARK_ORANGE,
+    RED,
+    YELLOW,
+    RGBData(0x80, 0x20, 0x00)
+};
+
 
 // Function Prototypes.
 static void initCandleFlicker();
+static void dumpI2CStats(int eye, const I2CDeviceStats* pStats);
 static int random(int low, int high);
 
 
@@ -78,21 +162,78 @@ int main()
     uint32_t             lastSetCount = 0;
     uint32_t             loopCounter = 0;
     EyeEffects           effectCounter = (EyeEffects)0;
-    static   NeoPixel    ledControl(LED_COUNT, p11);
+    EyeEffects           runningEffect = (EyeEffects)0;
+    static   NeoPixel    ledControl(NEOPIXEL_LED_COUNT, p11);
     static   Timer       timer;
-    static   I2C         i2cEyeMatrices(p9, p10);
-    static   EyeMatrices eyes(&i2cEyeMatrices, LEFT_EYE_I2C_ADDRESS, RIGHT_EYE_I2C_ADDRESS);
+    static   I2CAsync    i2cLeftEye(LEFT_EYE_I2C_SDA, LEFT_EYE_I2C_SCL);
+#if EYES_ON_SEPARATE_I2C_BUSES
+    static   I2CAsync    i2cRightEye(RIGHT_EYE_I2C_SDA, RIGHT_EYE_I2C_SCL);
+    I2CAsync*            pRightEyeI2C = &i2cRightEye;
+#else
+    I2CAsync*            pRightEyeI2C = &i2cLeftEye;
+#endif // EYES_ON_SEPARATE_I2C_BUSES
+    IEyeDisplay*         pEyeDisplays[EyeMatrices::DISPLAY_COUNT];
+#if USE_MAX7219_EYES
+    static   MAX7219Chain      max7219Chain(MAX7219_MOSI, MAX7219_SCLK, MAX7219_LOAD, EyeMatrices::DISPLAY_COUNT);
+    static   MAX7219EyeDisplay eyeDisplays[EyeMatrices::DISPLAY_COUNT];
+    max7219Chain.begin();
+    for (int i = 0 ; i < EyeMatrices::DISPLAY_COUNT ; i++)
+    {
+        eyeDisplays[i].begin(&max7219Chain, i);
+        pEyeDisplays[i] = &eyeDisplays[i];
+    }
+#elif USE_NEOPIXEL_EYES
+    static   NeoPixelEyeDisplay eyeDisplays[EyeMatrices::DISPLAY_COUNT];
+    EyeImage                    eyeBall = EyeMatrices::getEyeBallFrame();
+    for (int i = 0 ; i < EyeMatrices::DISPLAY_COUNT ; i++)
+    {
+        eyeDisplays[i].begin(&g_eyeColours, eyeBall.tiles[i % EYE_TILE_COUNT]);
+        pEyeDisplays[i] = &eyeDisplays[i];
+    }
+#elif USE_GRAYSCALE_EYES
+    static   HT16K33GrayscaleEyeDisplay eyeDisplays[EYE_COUNT];
+    for (int i = 0 ; i < EYE_COUNT ; i++)
+    {
+        eyeDisplays[i].begin((i & 1) ? pRightEyeI2C : &i2cLeftEye, FIRST_EYE_I2C_ADDRESS + i);
+        pEyeDisplays[i] = &eyeDisplays[i];
+    }
+#elif EYE_SIZE == 16
+    static   Adafruit_16x8matrix   eyeBackpacks[EYE_COUNT * 2];
+    static   HT16K33HalfEyeDisplay eyeDisplays[EyeMatrices::DISPLAY_COUNT];
+    for (int i = 0 ; i < EYE_COUNT * 2 ; i++)
+    {
+        int eye = i / 2;
+        eyeBackpacks[i].begin((eye & 1) ? pRightEyeI2C : &i2cLeftEye, FIRST_EYE_I2C_ADDRESS + i);
+        eyeBackpacks[i].setBrightness(0);
+    }
+    for (int i = 0 ; i < EyeMatrices::DISPLAY_COUNT ; i++)
+    {
+        eyeDisplays[i].begin(&eyeBackpacks[i / 2], i & 1);
+        pEyeDisplays[i] = &eyeDisplays[i];
+    }
+#else
+    static   HT16K33EyeDisplay eyeDisplays[EYE_COUNT];
+    for (int i = 0 ; i < EYE_COUNT ; i++)
+    {
+        eyeDisplays[i].begin((i & 1) ? pRightEyeI2C : &i2cLeftEye, FIRST_EYE_I2C_ADDRESS + i);
+        pEyeDisplays[i] = &eyeDisplays[i];
+    }
+#endif // USE_MAX7219_EYES
+    static   EyeMatrices eyes(pEyeDisplays);
     EyeState             eyeState = STATE_INIT;
-    EyeAnimationBase*    pCurrEyeAnimation = NULL;
-    DelayAnimation       delayAnimation(&eyes);
-    BlinkAnimation       blinkAnimation(&eyes);
-    MoveEyeAnimation     moveEyeAnimation(&eyes);
-    CrossEyesAnimation   crossEyesAnimation(&eyes);
-    RoundSpinAnimation   roundSpinAnimation(&eyes);
-    CrazySpinAnimation   crazySpinAnimation(&eyes);
-    MethEyesAnimation    methEyesAnimation(&eyes);
-    LazyEyeAnimation     lazyEyeAnimation(&eyes);
-    GlowEyesAnimation    glowEyesAnimation(&eyes);
+    EyeAnimationTracks   tracks(&eyes);
+    MainAnimationSlot    mainAnimation(&eyes);
+    BlinkAnimation       secondBlinkAnimation(&eyes);
+
+    if (RUN_INTERPOLATION_BENCHMARK)
+    {
+        runInterpolationBenchmark(LED_COUNT);
+    }
+
+#if USE_GRAYSCALE_EYES
+    // Use the extra levels of brightness to soften the edges of the pupils.
+    eyes.setSoftPupils(true);
+#endif // USE_GRAYSCALE_EYES
 
     initCandleFlicker();
     ledControl.start();
@@ -109,68 +250,120 @@ int main()
             printf("flips: %lu/sec    sets: %lu/sec\n",
                    flipCount / SECONDS_BETWEEN_COUNTER_DUMPS,
                    setCount / SECONDS_BETWEEN_COUNTER_DUMPS);
+#if USE_MAX7219_EYES
+            printf("MAX7219 packets: %lu\n", max7219Chain.getPacketCount());
+#elif USE_NEOPIXEL_EYES
+            for (int i = 0 ; i < EyeMatrices::DISPLAY_COUNT ; i++)
+            {
+                printf("eye tile %d: %lu renders\n", i, eyeDisplays[i].getRenderCount());
+            }
+#elif EYE_SIZE == 16
+            for (int i = 0 ; i < EYE_COUNT * 2 ; i++)
+            {
+                dumpI2CStats(i, eyeBackpacks[i].getStats());
+            }
+#else
+            for (int i = 0 ; i < EYE_COUNT ; i++)
+            {
+                dumpI2CStats(i, eyeDisplays[i].getStats());
+#if USE_GRAYSCALE_EYES
+                printf("eye %d: %lu refreshes/sec    %d planes    %lu overruns\n",
+                       i,
+                       eyeDisplays[i].getRefreshRate(),
+                       eyeDisplays[i].getActivePlaneCount(),
+                       eyeDisplays[i].getOverrunCount());
+#endif // USE_GRAYSCALE_EYES
+            }
+#endif // USE_MAX7219_EYES
 
             timer.reset();
 
             lastSetCount = currSetCount;
             lastFlipCount = currFlipCount;
         }
+#if USE_NEOPIXEL_EYES
+        // Compose the candle and the eyes into one frame so that it is only handed to the DMA hardware once. Each
+        // window is only encoded when its pixels have changed.
+        ledControl.beginFrame();
+        ledControl.setWindow(0, LED_COUNT);
         g_pCandleFlicker->updatePixels(ledControl);
+        for (int i = 0 ; i < EyeMatrices::DISPLAY_COUNT ; i++)
+        {
+            ledControl.setWindow(LED_COUNT + i * NEOPIXEL_EYE_LED_COUNT, NEOPIXEL_EYE_LED_COUNT);
+            eyeDisplays[i].updatePixels(ledControl);
+        }
+        ledControl.endFrame();
+#else
+        g_pCandleFlicker->updatePixels(ledControl);
+#endif // USE_NEOPIXEL_EYES
+
+        // Reset the eye matrix buses if a write has gotten stuck on either of them.
+        i2cLeftEye.checkTimeout();
+        pRightEyeI2C->checkTimeout();
+
+#if USE_GRAYSCALE_EYES
+        // Switch each eye to its next bit plane when it is time.
+        for (int i = 0 ; i < EYE_COUNT ; i++)
+        {
+            eyeDisplays[i].refresh();
+        }
+#endif // USE_GRAYSCALE_EYES
 
-        // Run the eye animation state machine.
-        if (pCurrEyeAnimation)
-            pCurrEyeAnimation->run();
+        // Give each animation track a turn, with one flush per eye for all of them, and then run the eye animation
+        // state machine.
+        tracks.run();
         switch (eyeState)
         {
         case STATE_INIT:
             // Center the eyes to initialize the state.
             // Start the delay timer before transitioning to the next state.
-            i2cEyeMatrices.frequency(400000);
+            i2cLeftEye.frequency(EYE_I2C_FREQUENCY);
+            pRightEyeI2C->frequency(EYE_I2C_FREQUENCY);
             eyes.init();
-            delayAnimation.start(MILLISECONDS_FOR_INITIAL_DELAY);
-            pCurrEyeAnimation = &delayAnimation;
+            mainAnimation.create<DelayAnimation>()->start(MILLISECONDS_FOR_INITIAL_DELAY);
+            tracks.play(TRACK_MAIN, mainAnimation.get());
             eyeState = STATE_INITIAL_DELAY;
             break;
         case STATE_INITIAL_DELAY:
             // Wait MILLISECONDS_FOR_INITIAL_DELAY msecs (2 seconds) before starting initial wink of the left eye.
-            assert ( pCurrEyeAnimation == &delayAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<DelayAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_INITIAL_LEFT_EYE_WINK;
-                blinkAnimation.start(true, false);
-                pCurrEyeAnimation = &blinkAnimation;
+                mainAnimation.create<BlinkAnimation>()->start(true, false);
+                tracks.play(TRACK_MAIN, mainAnimation.get());
             }
             break;
         case STATE_INITIAL_LEFT_EYE_WINK:
             // Winking the left eye.
             // Start winking the right eye once the left wink has completed.
-            assert ( pCurrEyeAnimation == &blinkAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<BlinkAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_INITIAL_RIGHT_EYE_WINK;
-                blinkAnimation.start(false, true);
-                pCurrEyeAnimation = &blinkAnimation;
+                mainAnimation.create<BlinkAnimation>()->start(false, true);
+                tracks.play(TRACK_MAIN, mainAnimation.get());
             }
             break;
         case STATE_INITIAL_RIGHT_EYE_WINK:
             // Winking the right eye.
             // Start a 1 second delay once the right wink has completed.
-            assert ( pCurrEyeAnimation == &blinkAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<BlinkAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_DELAY_AFTER_WINK;
-                delayAnimation.start(1000);
-                pCurrEyeAnimation = &delayAnimation;
+                mainAnimation.create<DelayAnimation>()->start(1000);
+                tracks.play(TRACK_MAIN, mainAnimation.get());
             }
             break;
         case STATE_DELAY_AFTER_WINK:
             // Delay for 1 second after initial wink.
             // Transition to STATE_START_LOOP to begin the main eye animation loop.
-            assert ( pCurrEyeAnimation == &delayAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<DelayAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_START_LOOP;
-                pCurrEyeAnimation = NULL;
+                tracks.stop(TRACK_MAIN);
             }
             break;
         case STATE_START_LOOP:
@@ -178,19 +371,27 @@ int main()
             // Increment the loop counter and start moving both eyes to a random position.
             loopCounter++;
             eyeState = STATE_MOVING_EYES;
-            moveEyeAnimation.start(random(-2, 2),
-                                   random(-2, 2),
-                                   50);
-            pCurrEyeAnimation = &moveEyeAnimation;
+            mainAnimation.create<MoveEyeAnimation>()->start(random(-2, 2) * EYE_SCALE,
+                                                            random(-2, 2) * EYE_SCALE,
+                                                            50,
+                                                            EyeMatrices::ALL_EYES_MASK,
+                                                            EASE_IN_OUT);
+            tracks.play(TRACK_MAIN, mainAnimation.get());
+            // Sometimes blink while the eyes are moving.
+            if (random(0, 7) == 0 && tracks.isDone(TRACK_BLINK))
+            {
+                secondBlinkAnimation.start(true, true);
+                tracks.play(TRACK_BLINK, &secondBlinkAnimation);
+            }
             break;
         case STATE_MOVING_EYES:
             // Moving eyes around to random offset.
             // Wait for the eye movement to complete and then start a random delay between 2.5 and 3 seconds.
-            assert ( pCurrEyeAnimation == &moveEyeAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<MoveEyeAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
-                delayAnimation.start(random(5, 6) * 500);
-                pCurrEyeAnimation = &delayAnimation;
+                mainAnimation.create<DelayAnimation>()->start(random(5, 6) * 500);
+                tracks.play(TRACK_MAIN, mainAnimation.get());
                 eyeState = STATE_DELAY_AFTER_MOVE;
             }
             break;
@@ -200,51 +401,51 @@ int main()
             //  Blink both eyes
             //      - or -
             //  Skip blink and enter STATE_EFFECT_CHOOSER to determine if a special eye animation should be started.
-            assert ( pCurrEyeAnimation == &delayAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<DelayAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 if (random(0, 4) == 0)
                 {
-                    blinkAnimation.start(true, true);
-                    pCurrEyeAnimation = &blinkAnimation;
+                    mainAnimation.create<BlinkAnimation>()->start(true, true);
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_BLINKING;
                 }
                 else
                 {
                     eyeState = STATE_EFFECT_CHOOSER;
-                    pCurrEyeAnimation = NULL;
+                    tracks.stop(TRACK_MAIN);
                 }
             }
             break;
         case STATE_BLINKING:
             // Waiting for randomly eye blink to complete.
             // Wait for eye blink to complete and then start a half second delay.
-            assert ( pCurrEyeAnimation == &blinkAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<BlinkAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_DELAY_AFTER_BLINK;
-                delayAnimation.start(500);
-                pCurrEyeAnimation = &delayAnimation;
+                mainAnimation.create<DelayAnimation>()->start(500);
+                tracks.play(TRACK_MAIN, mainAnimation.get());
             }
             break;
         case STATE_DELAY_AFTER_BLINK:
             // Delay for 0.5 second after blink.
             // Enter STATE_EFFECT_CHOOSER state to determine if a special eye animation should be started.
-            assert ( pCurrEyeAnimation == &delayAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<DelayAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_EFFECT_CHOOSER;
-                pCurrEyeAnimation = NULL;
+                tracks.stop(TRACK_MAIN);
             }
             break;
         case STATE_EFFECT_CHOOSER:
             // Check to see if it is time to start a special eye effect and if so, get that animation started.
-            assert ( pCurrEyeAnimation == NULL );
+            assert ( tracks.getAnimation(TRACK_MAIN) == NULL );
             if (EFFECT_ITERATION == 0 || loopCounter < EFFECT_ITERATION)
             {
                 // Not running an effect this iteration so go back to start of main animation loop.
                 eyeState = STATE_START_LOOP;
-                pCurrEyeAnimation = NULL;
+                tracks.stop(TRACK_MAIN);
             }
             else
             {
@@ -252,40 +453,60 @@ int main()
                 switch (effectCounter)
                 {
                 case EFFECT_CROSS_EYES:
-                    crossEyesAnimation.start();
-                    pCurrEyeAnimation = &crossEyesAnimation;
+                    mainAnimation.create<CrossEyesAnimation>()->start();
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_EFFECT_RUNNING;
                     break;
                 case EFFECT_ROUND_SPIN:
-                    roundSpinAnimation.start();
-                    pCurrEyeAnimation = &roundSpinAnimation;
+                    mainAnimation.create<RoundSpinAnimation>()->start();
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_EFFECT_RUNNING;
                     break;
                 case EFFECT_CRAZY_SPIN:
-                    crazySpinAnimation.start();
-                    pCurrEyeAnimation = &crazySpinAnimation;
+                    mainAnimation.create<CrazySpinAnimation>()->start();
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_EFFECT_RUNNING;
                     break;
                 case EFFECT_METH_EYES:
-                    methEyesAnimation.start();
-                    pCurrEyeAnimation = &methEyesAnimation;
+                    mainAnimation.create<MethEyesAnimation>()->start();
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_EFFECT_RUNNING;
                     break;
                 case EFFECT_LAZY_EYE:
-                    lazyEyeAnimation.start();
-                    pCurrEyeAnimation = &lazyEyeAnimation;
+                    mainAnimation.create<LazyEyeAnimation>()->start();
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_EFFECT_RUNNING;
                     break;
                 case EFFECT_CRAZY_BLINK:
-                    blinkAnimation.start(true, false);
-                    pCurrEyeAnimation = &blinkAnimation;
-                    // Enters a different state than other effects since it needs to start winking the right eye
-                    // once the left eye completes its wink.
-                    eyeState = STATE_CRAZY_BLINK_STARTED;
+                    // Wink the left eye and then have the right eye wink on its own track once the left eye has
+                    // opened again.
+                    mainAnimation.create<BlinkAnimation>()->start(true, false);
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
+                    secondBlinkAnimation.startEyes(EyeMatrices::RIGHT_EYES_MASK,
+                                                   2 * MILLISECONDS_FOR_BLINK_CLOSE + BLINK_FRAME_DELAY_DEFAULT);
+                    tracks.play(TRACK_BLINK, &secondBlinkAnimation);
+                    eyeState = STATE_EFFECT_RUNNING;
                     break;
                 case EFFECT_GLOW_EYES:
-                    glowEyesAnimation.start(3);
-                    pCurrEyeAnimation = &glowEyesAnimation;
+                    mainAnimation.create<GlowEyesAnimation>()->start(3);
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
+                    eyeState = STATE_EFFECT_RUNNING;
+                    break;
+                case EFFECT_DILATE_PUPILS:
+                    mainAnimation.create<DilatePupilsAnimation>()->start(2);
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
+                    eyeState = STATE_EFFECT_RUNNING;
+                    break;
+                case EFFECT_EXPRESSION:
+                    mainAnimation.create<ExpressionAnimation>()->start(
+                        (ExpressionAnimation::Expression)random(0, ExpressionAnimation::EXPRESSION_COUNT - 1),
+                        2000);
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
+                    eyeState = STATE_EFFECT_RUNNING;
+                    break;
+                case EFFECT_FLASH_EYES:
+                    mainAnimation.create<FlashEyesAnimation>()->start(HT16K33_BLINK_2HZ, 2000);
+                    tracks.play(TRACK_MAIN, mainAnimation.get());
                     eyeState = STATE_EFFECT_RUNNING;
                     break;
                 default:
@@ -295,40 +516,40 @@ int main()
                 }
 
                 loopCounter = 0;
+                runningEffect = effectCounter;
                 effectCounter = (EyeEffects)(effectCounter + 1);
                 if (effectCounter >= EFFECT_MAX)
                     effectCounter = (EyeEffects)0;
             }
             break;
-        case STATE_CRAZY_BLINK_STARTED:
-            // The crazy blink has started with the left pupil.
-            // Wait for left wink to complete and then start the right wink.
-            assert ( pCurrEyeAnimation == &blinkAnimation );
-            if (pCurrEyeAnimation->isDone())
-            {
-                eyeState = STATE_EFFECT_RUNNING;
-                blinkAnimation.start(false, true);
-                pCurrEyeAnimation = &blinkAnimation;
-            }
-            break;
         case STATE_EFFECT_RUNNING:
-            // An eye effect animation is now running.
-            // Wait for it to complete and then start a 1 second delay.
-            assert ( pCurrEyeAnimation != NULL );
-            if (pCurrEyeAnimation->isDone())
+            // An eye effect animation is now running, possibly on more than one track.
+            // Wait for all of them to complete and then start a 1 second delay.
+            assert ( tracks.getAnimation(TRACK_MAIN) != NULL );
+            if (tracks.isDone())
             {
+                // Report how far behind schedule the effect's rendering got and the I2C traffic saved by effects which
+                // let the display controllers do the work.
+                EyeAnimationBase* pEffect = tracks.getAnimation(TRACK_MAIN);
+                printf("effect %d: %lu ms max lateness\n", runningEffect, pEffect->getMaxLateness());
+                uint32_t bytesSaved = pEffect->getI2CBytesSaved();
+                if (bytesSaved > 0)
+                {
+                    printf("effect %d: saved ~%lu I2C bytes\n", runningEffect, bytesSaved);
+                }
+
                 eyeState = STATE_DELAY_AFTER_EFFECT;
-                delayAnimation.start(1000);
-                pCurrEyeAnimation = &delayAnimation;
+                mainAnimation.create<DelayAnimation>()->start(1000);
+                tracks.play(TRACK_MAIN, mainAnimation.get());
             }
             break;
         case STATE_DELAY_AFTER_EFFECT:
             // Delay for 1 second after an effect and then loop around to the top of the main animation loop again.
-            assert ( pCurrEyeAnimation == &delayAnimation );
-            if (pCurrEyeAnimation->isDone())
+            assert ( tracks.getAnimation(TRACK_MAIN) == mainAnimation.get<DelayAnimation>() );
+            if (tracks.isDone(TRACK_MAIN))
             {
                 eyeState = STATE_START_LOOP;
-                pCurrEyeAnimation = NULL;
+                tracks.stop(TRACK_MAIN);
             }
             break;
         case STATE_DONE:
@@ -352,6 +573,20 @@ static void initCandleFlicker()
     g_pCandleFlicker = &flicker;
 }
 
+static void dumpI2CStats(int eye, const I2CDeviceStats* pStats)
+{
+    printf("eye %d: %lu bytes    %lu writes    %lu NAKs    %lu retries    %lu timeouts    %lu us max latency    "
+           "%lu skipped\n",
+           eye,
+           pStats->bytesSent,
+           pStats->completed,
+           pStats->naks,
+           pStats->retries,
+           pStats->timeouts,
+           pStats->maxLatency,
+           pStats->skipped);
+}
+
 // Returns a random number between low and high, inclusively.
 static int random(int low, int high)
 {
@@ -0,0 +1,168 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Host harness for the division free colour interpolation in AnimationBase::interpolateHsvToRgbByFraction(). It
+// checks that each interpolated HSV channel stays within 1 LSB of the division based interpolation which it replaced
+// (and is identical for interpolations of up to 256 steps), and then times the two on the PC.
+#include <mbed.h>
+#include <assert.h>
+#include <random>
+#include <vector>
+#include "InterpolationBenchmark.h"
+
+// Pulled in directly so that the file static interpolateChannel() can be checked at the HSV level, before the
+// brightness curve hides which channel values differed.
+#include "Animation.cpp"
+
+
+// Animation.cpp sends its pixels to the NeoPixel strip but the harness never calls those methods.
+void NeoPixel::set(const RGBData* pPixels, size_t pixelCount)
+{
+}
+
+LPC_GPDMA_TypeDef* LPC_GPDMA;
+LPC_SC_TypeDef*    LPC_SC;
+
+
+// The per channel arithmetic of interpolateWithDivision().
+static int32_t divideChannel(int32_t prev, int32_t next, int32_t curr, int32_t total)
+{
+    return prev + ((next - prev) * curr) / total;
+}
+
+struct AccuracyStats
+{
+    uint64_t compared;
+    uint64_t differing;
+    int32_t  maxDiff;
+};
+
+// Both interpolations only depend on the change from prev to next so every change from -255 to 255 is checked, from
+// the end of the range which keeps the result within 0 - 255.
+static void compareChannels(AccuracyStats* pStats, int32_t curr, int32_t total, uint32_t fraction)
+{
+    for (int32_t delta = -255 ; delta <= 255 ; delta++)
+    {
+        int32_t prev = delta < 0 ? 255 : 0;
+        int32_t next = prev + delta;
+        int32_t diff = abs(interpolateChannel(prev, next, fraction) - divideChannel(prev, next, curr, total));
+
+        pStats->compared++;
+        if (diff != 0)
+            pStats->differing++;
+        if (diff > pStats->maxDiff)
+            pStats->maxDiff = diff;
+    }
+}
+
+static void compareInterpolation(AccuracyStats* pStats, int32_t curr, int32_t total)
+{
+    compareChannels(pStats, curr, total, AnimationBase::calculateInterpolationFraction(curr, total));
+}
+
+static bool checkAccuracy()
+{
+    static const int32_t exhaustiveTotal = 4096;
+    static const int32_t maxTotal = 200000;
+    static const int     sampledTotals = 2000;
+    static const int     sampledSteps = 1000;
+    std::mt19937         random(1);
+    AccuracyStats        shortStats = { 0, 0, 0 };
+    AccuracyStats        longStats = { 0, 0, 0 };
+
+    // Every step of every interpolation up to exhaustiveTotal steps long.
+    for (int32_t total = 1 ; total <= exhaustiveTotal ; total++)
+    {
+        AccuracyStats* pStats = total <= 256 ? &shortStats : &longStats;
+        for (int32_t curr = 0 ; curr <= total ; curr++)
+            compareInterpolation(pStats, curr, total);
+    }
+
+    // Random steps of random interpolations up to maxTotal steps long, always including both ends.
+    std::uniform_int_distribution<int32_t> totalDistribution(exhaustiveTotal + 1, maxTotal);
+    for (int i = 0 ; i < sampledTotals ; i++)
+    {
+        int32_t                                total = totalDistribution(random);
+        std::uniform_int_distribution<int32_t> currDistribution(0, total);
+
+        compareInterpolation(&longStats, 0, total);
+        compareInterpolation(&longStats, total, total);
+        for (int j = 0 ; j < sampledSteps ; j++)
+            compareInterpolation(&longStats, currDistribution(random), total);
+    }
+
+    printf("HSV channels, 1 - 256 steps: %llu compared, %llu differ, max diff %ld\n",
+           (unsigned long long)shortStats.compared, (unsigned long long)shortStats.differing,
+           (long)shortStats.maxDiff);
+    printf("HSV channels, 257 - %ld steps: %llu compared, %llu differ (%.4f%%), max diff %ld\n",
+           (long)maxTotal, (unsigned long long)longStats.compared, (unsigned long long)longStats.differing,
+           100.0 * longStats.differing / longStats.compared, (long)longStats.maxDiff);
+
+    return shortStats.differing == 0 && longStats.maxDiff <= 1;
+}
+
+static void timeInterpolation(int pixelCount, int32_t totalTime)
+{
+    std::vector<HSVData> hsvStart(pixelCount);
+    std::vector<HSVData> hsvStop(pixelCount);
+    std::vector<RGBData> rgb(pixelCount);
+    uint32_t             checksum = 0;
+    Timer                timer;
+
+    for (int i = 0 ; i < pixelCount ; i++)
+    {
+        hsvStart[i].hue = rand();
+        hsvStart[i].saturation = rand();
+        hsvStart[i].value = rand();
+        hsvStop[i].hue = rand();
+        hsvStop[i].saturation = rand();
+        hsvStop[i].value = rand();
+    }
+
+    timer.start();
+    for (int32_t curr = 0 ; curr <= totalTime ; curr++)
+    {
+        for (int i = 0 ; i < pixelCount ; i++)
+            interpolateWithDivision(&rgb[i], &hsvStart[i], &hsvStop[i], curr, totalTime);
+        checksum += rgb[curr % pixelCount].red;
+    }
+    int divideTime = timer.read_us();
+
+    timer.reset();
+    for (int32_t curr = 0 ; curr <= totalTime ; curr++)
+    {
+        uint32_t fraction = AnimationBase::calculateInterpolationFraction(curr, totalTime);
+        for (int i = 0 ; i < pixelCount ; i++)
+            AnimationBase::interpolateHsvToRgbByFraction(&rgb[i], &hsvStart[i], &hsvStop[i], fraction);
+        checksum += rgb[curr % pixelCount].red;
+    }
+    int fractionTime = timer.read_us();
+
+    double pixels = (double)pixelCount * (totalTime + 1);
+    printf("%d pixels x %ld steps: divide %.2f ns/pixel    fraction %.2f ns/pixel    (checksum %lu)\n",
+           pixelCount, (long)totalTime + 1, divideTime * 1000.0 / pixels, fractionTime * 1000.0 / pixels,
+           (unsigned long)checksum);
+}
+
+int main()
+{
+    bool isAccurate = checkAccuracy();
+
+    // The same benchmark that main.cpp can run on the target, followed by a longer run for steadier PC timings.
+    runInterpolationBenchmark(16);
+    timeInterpolation(1024, 10000);
+
+    printf("%s\n", isAccurate ? "PASS" : "FAIL");
+    return isAccurate ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+/* Copyright (C) 2016  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+// Just enough of mbed for the firmware's colour interpolation code to be built and run on a PC.
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#define __IO        volatile
+#define __INLINE    inline
+
+typedef enum
+{
+    p11 = 11,
+    NC = -1
+} PinName;
+
+typedef struct
+{
+    __IO uint32_t DMACCSrcAddr;
+    __IO uint32_t DMACCDestAddr;
+    __IO uint32_t DMACCLLI;
+    __IO uint32_t DMACCControl;
+    __IO uint32_t DMACCConfig;
+} LPC_GPDMACH_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t DMACConfig;
+} LPC_GPDMA_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t PCONP;
+} LPC_SC_TypeDef;
+
+extern LPC_GPDMA_TypeDef* LPC_GPDMA;
+extern LPC_SC_TypeDef*    LPC_SC;
+
+// Microseconds from the PC's steady clock instead of the LPC1768's microsecond ticker.
+static inline uint32_t us_ticker_read(void)
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+namespace mbed
+{
+
+class SPI
+{
+public:
+    SPI(PinName, PinName, PinName) {}
+};
+
+class Timer
+{
+public:
+    Timer() : m_start(us_ticker_read()) {}
+
+    void start()
+    {
+        reset();
+    }
+    void reset()
+    {
+        m_start = us_ticker_read();
+    }
+    int read_us()
+    {
+        return us_ticker_read() - m_start;
+    }
+    int read_ms()
+    {
+        return read_us() / 1000;
+    }
+
+protected:
+    uint32_t m_start;
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif // MBED_H